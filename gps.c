@@ -6,12 +6,130 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
 #include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
 #include "gps.h"
 #include "nmea.h"
 #include "serial.h"
+#include "gpsreplay.h"
+#include "ubx.h"
 
-nmeamsg_s gpsbuffer[GPSBUFFERSZ] = {0};
+// Simulated receiver log, shared read only by the ingestion thread and gps_location()
+#if GPSUBX
+static ubxcapture_t gpsubxlog;
+#elif SIMGPS
+static gpsreplay_s gpslog;
+#endif
+
+// Latest fix, written by the ingestion thread only and read through the sequence counter
+static gpsfix_s gpsshared;
+static unsigned gpsseq = 0;
+static pthread_t gpsthread;
+static volatile int gpsrunning = 0;
+
+// Surveyed site, written once by gps_init() or the ingestion thread before gpslocked is set
+static gpssite_s gpssite;
+static int gpslocked = 0;
+
+// Running mean and sum of squared deviations of the fixes, north/east relative to the first
+typedef struct gpssurvey
+{
+    unsigned long n;
+    double start, last;             // GpsNow() of the first and last averaged fix
+    double lat0, lon0, coslat0;
+    double north, east, altitude;   // means [m]
+    double m2north, m2east;         // sums of squared deviations [m^2]
+} gpssurvey_s;
+
+/** \brief Seconds on the monotonic clock
+ *
+ * \param void
+ * \return double seconds
+ */
+static double GpsNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#if !SIMGPS
+/** \brief Send a PMTK command to the receiver, the checksum is added here
+ *
+ * \param command without '$' and checksum, printf style
+ * \return int 1 if queued, 0 otherwise
+ */
+static int GpsCommand(const char *fmt, ...)
+{
+    char body[GPSDATASZ], line[GPSDATASZ];
+    uint8_t sum = 0;
+    va_list ap;
+    int i, n;
+
+    va_start(ap, fmt);
+    vsnprintf(body, sizeof(body), fmt, ap);
+    va_end(ap);
+    for(i = 0; body[i] != '\0'; i++) { sum ^= (uint8_t)body[i]; }
+    n = snprintf(line, sizeof(line), "$%s*%02X", body, sum);
+
+    return serial_println(line, n);
+}
+
+/** \brief Wait for a sentence with a valid checksum
+ *
+ * \param timeout in milliseconds
+ * \return int 1 once one is received, 0 on timeout or a UART error
+ */
+static int GpsWaitSentence(int timeout)
+{
+    char buffer[GPSDATASZ];
+    double end = GpsNow() + timeout / 1000.0;
+    int n;
+
+    while(GpsNow() < end)
+    {
+        n = serial_readln_timeout(buffer, GPSDATASZ, timeout);
+        if(n < 0) { return 0; }
+        if(n > 0 && buffer[n - 1] == '\r') { buffer[n - 1] = '\0'; }
+        if(n > 0 && nmea_valid_checksum(buffer) != NMEA_CHECKSUM_ERR) { return 1; }
+    }
+
+    return 0;
+}
+
+/** \brief Switch the receiver and the UART to GPSFASTBAUD and GPSRATEHZ fixes per second
+ *
+ * The receiver only sends GGA, RMC and GSA, so 10 Hz needs about 2.2 kB/s, more than 9600
+ * baud carries.  If no valid sentence arrives at the new speed the receiver did not follow
+ * and the UART goes back to GPSBAUD.  A receiver already at GPSFASTBAUD, after a restart of
+ * this program, ignores the command sent at 9600 and is found at the new speed anyway.
+ *
+ * \param void
+ * \return int 1 on success, 0 if the receiver stays at GPSBAUD and 1 Hz
+ */
+static int GpsConfigureRate(void)
+{
+    GpsCommand("PMTK251,%d", GPSFASTBAUD);
+    if(!serial_set_baud(GPSFASTBAUD)) { return 0; }
+    if(!GpsWaitSentence(GPSCONFIGWAIT))
+    {
+        serial_set_baud(GPSBAUD);
+        return 0;
+    }
+
+    // GLL, RMC, VTG, GGA, GSA, GSV, ... output every n fixes
+    GpsCommand("PMTK314,0,1,0,1,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0");
+    GpsCommand("PMTK220,%d", 1000 / GPSRATEHZ);
+    serial_tx_flush(SERIALTXFLUSH);
+
+    return 1;
+}
+#endif
 
 /** \brief Initialize GPS
  *
@@ -22,13 +140,29 @@ nmeamsg_s gpsbuffer[GPSBUFFERSZ] = {0};
  */
 extern void gps_init(void)
 {
-#if SIMGPS
-    StReadGPSData("gpslog01.txt");
-	//StReadGPSData("gpslog02.txt");
+#if GPSSURVEY
+    // A surveyed site needs no receiver at all
+    if(gps_load_site(&gpssite, GPSSITEFILE))
+    {
+        __atomic_store_n(&gpslocked, 1, __ATOMIC_RELEASE);
+        return;
+    }
+#endif
+#if SIMGPS && GPSUBX
+    if(!ubx_capture_open(&gpsubxlog, GPSUBXFILE)) { return; }
+#elif SIMGPS
+    if(!gpsreplay_open(&gpslog, GPSREPLAYFILE)) { return; }
 #else
-	//serial_init();
-	//serial_config();
+	serial_init();
+	serial_config();
+#if GPSRATEHZ > 1
+    if(!GpsConfigureRate())
+    {
+        fprintf(stderr, "GPS did not answer at %d baud, staying at %d baud and 1 Hz\n", GPSFASTBAUD, GPSBAUD);
+    }
 #endif
+#endif
+    gps_start();
 }
 
 /** \brief Turn on GPS
@@ -43,6 +177,162 @@ extern void gps_on(void)
     //Write on
 }
 
+/** \brief Collect records from the streaming parser into a location
+ *
+ * GPGGA and GPRMC fill the location, GPGSA and GPGSV the fix quality figures.
+ *
+ * \param message type, nmearecord_t member selected by the type, gpsfill_s structure
+ * \return void
+ */
+static void GpsCollect(uint8_t type, const void *record, void *ctx)
+{
+    gpsfill_s *fill = (gpsfill_s *)ctx;
+    const gpgga_t *gpgga;
+    const gprmc_t *gprmc;
+    const gpgsa_t *gpgsa;
+
+    switch(type)
+    {
+        case NMEA_GPGGA:
+            gpgga = (const gpgga_t *)record;
+            fill->quality = gpgga->quality;
+            fill->satellites = gpgga->satellites;
+            fill->loc.utc = gpgga->utc;
+            fill->loc.latitude = gpgga->latmicro / (double)NMEAMICRO;
+            fill->loc.longitude = gpgga->lonmicro / (double)NMEAMICRO;
+            fill->loc.altitude = gpgga->altitude;
+            fill->status |= NMEA_GPGGA;
+            break;
+        case NMEA_GPRMC:
+            gprmc = (const gprmc_t *)record;
+            fill->loc.speed = gprmc->speed;
+            fill->loc.course = gprmc->course;
+            fill->loc.date = gprmc->date;
+            fill->status |= NMEA_GPRMC;
+            break;
+        case NMEA_GPGSA:
+            gpgsa = (const gpgsa_t *)record;
+            fill->fix = gpgsa->fix;
+            fill->pdop = gpgsa->pdop;
+            fill->hdop = gpgsa->hdop;
+            fill->vdop = gpgsa->vdop;
+            fill->status |= NMEA_GPGSA;
+            break;
+        case NMEA_GPGSV:
+            fill->visible = ((const gpgsv_t *)record)->visible;
+            fill->status |= NMEA_GPGSV;
+            break;
+    }
+}
+
+#if GPSUBX
+/** \brief Collect UBX NAV-PVT and NAV-TIMEUTC records into a location
+ *
+ * A NAV-PVT carries everything a GPGGA and GPRMC pair does, so it marks both as seen.  The
+ * time and date are stored in the NMEA hhmmss.sss and ddmmyy forms to give the same loc_t.
+ *
+ * \param UBX class and id, ubxpvt_t or ubxtimeutc_t record, gpsfill_s structure
+ * \return void
+ */
+static void GpsCollectUbx(uint8_t cls, uint8_t id, const void *record, void *ctx)
+{
+    gpsfill_s *fill = (gpsfill_s *)ctx;
+    const ubxpvt_t *pvt;
+    const ubxtimeutc_t *utc;
+
+    if(cls != UBX_CLASS_NAV) { return; }
+
+    if(id == UBX_NAV_PVT)
+    {
+        pvt = (const ubxpvt_t *)record;
+        if(pvt->valid & UBX_PVT_VALIDTIME)
+        {
+            fill->loc.utc = pvt->hour * 10000.0 + pvt->minute * 100.0 + pvt->second +
+                            ((pvt->nano > 0) ? pvt->nano / 1e9 : 0.0);
+        }
+        if(pvt->valid & UBX_PVT_VALIDDATE)
+        {
+            fill->loc.date = pvt->day * 10000.0 + pvt->month * 100.0 + pvt->year % 100;
+        }
+        fill->loc.latitude = pvt->lat / 1e7;
+        fill->loc.longitude = pvt->lon / 1e7;
+        fill->loc.altitude = pvt->hmsl / 1000.0;
+        fill->loc.speed = pvt->gspeed / 1000.0 * GPSKNOTS;
+        fill->loc.course = pvt->headmot / 1e5;
+
+        fill->quality = 0;
+        if((pvt->flags & UBX_PVT_GNSSFIXOK) && pvt->fixtype >= UBX_FIX_2D && pvt->fixtype <= UBX_FIX_GNSSDR)
+        {
+            fill->quality = (pvt->flags & UBX_PVT_DIFFSOLN) ? 2 : 1;
+        }
+        fill->satellites = pvt->numsv;
+        fill->fix = (pvt->fixtype == UBX_FIX_2D) ? 2 :
+                    (pvt->fixtype == UBX_FIX_3D || pvt->fixtype == UBX_FIX_GNSSDR) ? 3 : 1;
+        fill->pdop = pvt->pdop * 0.01;
+        fill->itow = pvt->itow;
+        fill->status |= NMEA_GPGGA | NMEA_GPRMC;
+    }
+    else if(id == UBX_NAV_TIMEUTC)
+    {
+        utc = (const ubxtimeutc_t *)record;
+        if(!(utc->valid & UBX_TIMEUTC_VALIDUTC)) { return; }
+        fill->loc.utc = utc->hour * 10000.0 + utc->minute * 100.0 + utc->second +
+                        ((utc->nano > 0) ? utc->nano / 1e9 : 0.0);
+        fill->loc.date = utc->day * 10000.0 + utc->month * 100.0 + utc->year % 100;
+    }
+}
+
+/** \brief Feed the UBX parser with the next record of the capture or the next UART read
+ *
+ * \param ubxstream_t structure, capture cursor (SIMGPS), non-zero to loop the capture
+ * \return int 1 while there is data, 0 at the end of the capture or on a UART error
+ */
+static int GpsFeedUbx(ubxstream_t *ubx, ubxcapture_t *cap, int loop)
+{
+#if SIMGPS
+    return ubx_capture_feed(cap, ubx, 1, loop) > 0;
+#else
+    char buffer[GPSDATASZ];
+    int n;
+
+    (void)cap;
+    (void)loop;
+    n = serial_read_timeout(buffer, GPSDATASZ, SERIALTIMEOUT);
+    if(n < 0) { return 0; }
+    ubx_stream_feed(ubx, (const uint8_t *)buffer, n);
+    return 1;
+#endif
+}
+#endif
+
+#if !SIMGPS
+/** \brief Wait for the next fix of the ingestion thread, which owns the UART while it runs
+ *
+ * \param loc_t structure to fill
+ * \return int 1 if the thread is running and loc has been filled, 0 otherwise
+ */
+static int GpsNextFix(loc_t *loc)
+{
+    gpsfix_s fix;
+    unsigned long count;
+    double end;
+
+    if(!gpsrunning) { return 0; }
+
+    gps_get_fix(&fix);
+    count = fix.count;
+    end = GpsNow() + GPSLOCATIONWAIT / 1000.0;
+    while(fix.count == count && GpsNow() < end)
+    {
+        usleep(1000000 / GPSRATEHZ / 10);
+        gps_get_fix(&fix);
+    }
+    *loc = fix.loc;
+
+    return 1;
+}
+#endif
+
 /** \brief Compute the GPS location using decimal scale
  *
  * \param void
@@ -52,45 +342,367 @@ extern void gps_on(void)
  */
 loc_t gps_location(void)
 {
-    uint8_t status = _EMPTY;
-    loc_t cloc = { 0.0 };
-    gpgga_t gpgga;
-    gprmc_t gprmc;
-    int i = 0;
+    gpsfill_s fill = {{0.0}, _EMPTY, 0, 0};
+#if GPSUBX
+    ubxstream_t ubx;
+    ubxcapture_t cap = gpsubxlog;
+
+#if !SIMGPS
+    // At 5-10 Hz the sentences queued since the last call are stale, start from the next one
+    if(GpsNextFix(&fill.loc)) { return fill.loc; }
+    serial_discard();
+#endif
+    cap.pos = 0;
+    ubx_stream_init(&ubx, GpsCollectUbx, &fill);
+    while((fill.status & _COMPLETED) != _COMPLETED)
+    {
+        if(!GpsFeedUbx(&ubx, &cap, 0)) { break; }
+    }
+    return fill.loc;
+#else
+    nmeastream_t stream;
+#if SIMGPS
+    gpsplayer_s player;
+
+    gpsplayer_init(&player, &gpslog, GPSWARPFAST, 0);
+#else
     char buffer[GPSDATASZ];
 
-    while(status != _COMPLETED)
+    if(GpsNextFix(&fill.loc)) { return fill.loc; }
+    serial_discard();
+#endif
+
+    nmea_stream_init(&stream, GpsCollect, &fill);
+    while((fill.status & _COMPLETED) != _COMPLETED)
 	{
 #if SIMGPS
-        strncpy(buffer,gpsbuffer[i].msgstr,NMEAMSGSZ+1);
-        i++;
-        if(i > GPSBUFFERSZ) { break;}
+        if(gpsplayer_feed(&player, &stream, 1) == 0) { break; }
 #else
         serial_readln(buffer,GPSDATASZ);
+        nmea_stream_feed(&stream, buffer, strlen(buffer));
+        nmea_stream_feed(&stream, "\n", 1);
 #endif
-        switch (nmea_get_message_type(buffer))
-		{
-            case NMEA_GPGGA:
-                nmea_parse_gpgga(buffer, &gpgga);
-                cloc.utc = gpgga.utc;
-                gps_convert_deg_to_dec(&(gpgga.latitude), gpgga.lat, &(gpgga.longitude), gpgga.lon);
-                cloc.latitude = gpgga.latitude;
-                cloc.longitude = gpgga.longitude;
-                cloc.altitude = gpgga.altitude;
-                status |= NMEA_GPGGA;
-                break;
-            case NMEA_GPRMC:
-                nmea_parse_gprmc(buffer, &gprmc);
-                cloc.speed = gprmc.speed;
-                cloc.course = gprmc.course;
-                cloc.date = gprmc.date;
-                status |= NMEA_GPRMC;
-                break;
+    }
+    return fill.loc;
+#endif
+}
+
+
+/** \brief Publish a fix for gps_get_fix(), only called from the ingestion thread
+ *
+ * The sequence counter is odd while the fix is being written, readers retry until they
+ * see the same even value before and after their copy.
+ *
+ * \param gpsfill_s structure with a complete fix
+ * \return void
+ */
+static void GpsPublish(const gpsfill_s *fill)
+{
+    __atomic_store_n(&gpsseq, gpsseq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    gpsshared.loc = fill->loc;
+    gpsshared.quality = fill->quality;
+    gpsshared.satellites = fill->satellites;
+    gpsshared.fix = fill->fix;
+    gpsshared.visible = fill->visible;
+    gpsshared.pdop = fill->pdop;
+    gpsshared.hdop = fill->hdop;
+    gpsshared.vdop = fill->vdop;
+    gpsshared.time = GpsNow();
+    gpsshared.count++;
+
+    __atomic_store_n(&gpsseq, gpsseq + 1, __ATOMIC_RELEASE);
+}
+
+#if GPSSURVEY
+/** \brief Average a fix into the site survey
+ *
+ * Only fixes with a position solution are averaged, one every GPSSURVEYINTERVAL seconds:
+ * consecutive fixes share most of their error, and averaging them all would shrink the
+ * standard error on paper only.  The site is locked once the survey has run for
+ * GPSSURVEYMINTIME and at least GPSSURVEYMINFIXES fixes give a standard error of the mean
+ * horizontal position within GPSSURVEYPRECISION.  It is then saved to GPSSITEFILE, except
+ * in SIMGPS builds, where the replayed log is not the real site.
+ *
+ * \param gpssurvey_s structure, gpsfill_s structure with a complete fix
+ * \return int 1 once the site is locked, 0 while surveying
+ */
+static int GpsSurvey(gpssurvey_s *sv, const gpsfill_s *fill)
+{
+    double north, east, dnorth, deast, precision, now;
+
+    if(fill->quality == 0 || fill->fix == 1) { return 0; }
+    if(fill->hdop > GPSFIXMAXHDOP) { return 0; }
+    now = GpsNow();
+    if(sv->n > 0 && now - sv->last < GPSSURVEYINTERVAL) { return 0; }
+    sv->last = now;
+
+    if(sv->n == 0)
+    {
+        sv->start = now;
+        sv->lat0 = fill->loc.latitude;
+        sv->lon0 = fill->loc.longitude;
+        sv->coslat0 = cos(sv->lat0 * M_PI / 180.0);
+    }
+    north = (fill->loc.latitude - sv->lat0) * M_PI / 180.0 * GPSEARTHRADIUS;
+    east = (fill->loc.longitude - sv->lon0) * M_PI / 180.0 * GPSEARTHRADIUS * sv->coslat0;
+
+    sv->n++;
+    dnorth = north - sv->north;
+    deast = east - sv->east;
+    sv->north += dnorth / sv->n;
+    sv->east += deast / sv->n;
+    sv->altitude += (fill->loc.altitude - sv->altitude) / sv->n;
+    sv->m2north += dnorth * (north - sv->north);
+    sv->m2east += deast * (east - sv->east);
+
+    if(sv->n < GPSSURVEYMINFIXES || now - sv->start < GPSSURVEYMINTIME) { return 0; }
+    precision = sqrt((sv->m2north + sv->m2east) / (sv->n - 1) / sv->n);
+    if(precision > GPSSURVEYPRECISION) { return 0; }
+
+    gpssite.latitude = sv->lat0 + sv->north / GPSEARTHRADIUS * 180.0 / M_PI;
+    gpssite.longitude = sv->lon0 + sv->east / (GPSEARTHRADIUS * sv->coslat0) * 180.0 / M_PI;
+    gpssite.altitude = sv->altitude;
+    gpssite.precision = precision;
+    gpssite.fixes = sv->n;
+#if !SIMGPS
+    gps_save_site(&gpssite, GPSSITEFILE);
+#endif
+    __atomic_store_n(&gpslocked, 1, __ATOMIC_RELEASE);
+
+    return 1;
+}
+#endif
+
+/** \brief Ingestion thread, parses sentences continuously and publishes every fix
+ *
+ * A fix is published on each GPGGA once a GPRMC has been seen, so speed, course and date
+ * come from the latest GPRMC.  With GPSSURVEY the thread ends, and powers the GPS down,
+ * once the site is locked.
+ *
+ * \param unused
+ * \return NULL
+ */
+static void *GpsIngest(void *arg)
+{
+    gpsfill_s fill = {{0.0}, _EMPTY, 0, 0};
+    gpssurvey_s survey = {0};
+#if GPSUBX
+    ubxstream_t ubx;
+    ubxcapture_t cap = gpsubxlog;
+#if SIMGPS
+    struct timespec ts;
+    uint32_t itowlast = 0;
+    double wait;
+#endif
+
+    (void)arg;
+    cap.pos = 0;
+    ubx_stream_init(&ubx, GpsCollectUbx, &fill);
+
+    while(gpsrunning)
+    {
+        if(!GpsFeedUbx(&ubx, &cap, 1)) { sleep(1); continue; }
+        if((fill.status & _COMPLETED) != _COMPLETED) { continue; }
+#if SIMGPS
+        // Pace the capture by its time of week, which wraps weekly and restarts on a loop
+        if(itowlast != 0 && fill.itow > itowlast)
+        {
+            wait = (fill.itow - itowlast) / 1000.0 / GPSREPLAYWARP;
+            ts.tv_sec = (time_t)wait;
+            ts.tv_nsec = (long)((wait - ts.tv_sec) * 1e9);
+            nanosleep(&ts, NULL);
         }
+        itowlast = fill.itow;
+#endif
+        GpsPublish(&fill);
+        fill.status = _EMPTY;
+#if GPSSURVEY
+        if(GpsSurvey(&survey, &fill)) { break; }
+#endif
     }
-    return cloc;
+#else
+    nmeastream_t stream;
+    uint8_t seen = _EMPTY;
+#if SIMGPS
+    gpsplayer_s player;
+
+    gpsplayer_init(&player, &gpslog, GPSREPLAYWARP, 1);
+#else
+    char buffer[GPSDATASZ];
+    int n;
+#endif
+
+    (void)arg;
+    nmea_stream_init(&stream, GpsCollect, &fill);
+
+    while(gpsrunning)
+    {
+#if SIMGPS
+        gpsplayer_feed(&player, &stream, 1);
+#else
+        n = serial_readln_timeout(buffer, GPSDATASZ, SERIALTIMEOUT);
+        if(n < 0) { sleep(1); continue; }
+        nmea_stream_feed(&stream, buffer, n);
+        nmea_stream_feed(&stream, "\n", 1);
+#endif
+        seen |= fill.status;
+        if((fill.status & NMEA_GPGGA) && (seen & NMEA_GPRMC))
+        {
+            GpsPublish(&fill);
+#if GPSSURVEY
+            if(GpsSurvey(&survey, &fill)) { break; }
+#endif
+        }
+        fill.status = _EMPTY;
+    }
+#endif
+
+    // Locked: nobody will join the thread unless gps_stop() has already claimed it
+    if(__atomic_load_n(&gpslocked, __ATOMIC_ACQUIRE))
+    {
+        if(__atomic_exchange_n(&gpsrunning, 0, __ATOMIC_ACQ_REL)) { pthread_detach(pthread_self()); }
+        gps_off();
+    }
+    (void)survey;
+
+    return NULL;
 }
 
+/** \brief Start the background ingestion thread
+ *
+ * \param void
+ * \return int 1 on success, 0 on failure
+ */
+int gps_start(void)
+{
+    if(gpsrunning) { return 1; }
+    if(__atomic_load_n(&gpslocked, __ATOMIC_ACQUIRE)) { return 0; }
+
+    gpsrunning = 1;
+    if(pthread_create(&gpsthread, NULL, GpsIngest, NULL) != 0)
+    {
+        gpsrunning = 0;
+        return 0;
+    }
+    return 1;
+}
+
+/** \brief Stop the background ingestion thread
+ *
+ * \param void
+ * \return void
+ */
+void gps_stop(void)
+{
+    // The thread may be ending on its own after a survey, only one side releases it
+    if(!__atomic_exchange_n(&gpsrunning, 0, __ATOMIC_ACQ_REL)) { return; }
+
+    pthread_join(gpsthread, NULL);
+}
+
+/** \brief Copy the latest fix published by the ingestion thread
+ *
+ * \param gpsfix_s structure to fill
+ * \return int 1 if a fix has been published, 0 otherwise
+ */
+int gps_get_fix(gpsfix_s *fix)
+{
+    unsigned seq;
+
+    do
+    {
+        seq = __atomic_load_n(&gpsseq, __ATOMIC_ACQUIRE);
+        *fix = gpsshared;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while((seq & 1) || seq != __atomic_load_n(&gpsseq, __ATOMIC_RELAXED));
+
+    return fix->count > 0;
+}
+
+/** \brief Age of a fix
+ *
+ * \param gpsfix_s structure from gps_get_fix()
+ * \return double seconds since it was published
+ */
+double gps_fix_age(const gpsfix_s *fix)
+{
+    return GpsNow() - fix->time;
+}
+
+/** \brief Check that a fix is recent and precise enough to position the tracker
+ *
+ * The GPGGA quality must report a position solution.  Receivers that send no GPGSA leave the
+ * DOP at 0, their fixes are gated on quality and age only, as in GpsSurvey().
+ *
+ * \param gpsfix_s structure from gps_get_fix()
+ * \return int 1 if the fix can be used, 0 otherwise
+ */
+int gps_fix_usable(const gpsfix_s *fix)
+{
+    if(gps_fix_age(fix) >= GPSFIXMAXAGE) { return 0; }
+    if(fix->quality == 0) { return 0; }
+    if(fix->fix == 1) { return 0; }
+    if(fix->hdop > GPSFIXMAXHDOP) { return 0; }
+
+    return 1;
+}
+
+/** \brief Copy the surveyed site
+ *
+ * \param gpssite_s structure to fill
+ * \return int 1 if the site is locked, 0 while surveying or without GPSSURVEY
+ */
+int gps_get_site(gpssite_s *site)
+{
+    if(!__atomic_load_n(&gpslocked, __ATOMIC_ACQUIRE)) { return 0; }
+
+    *site = gpssite;
+    return 1;
+}
+
+/** \brief Read a surveyed site file
+ *
+ * \param gpssite_s structure to fill, file name
+ * \return int 1 on success, 0 if the file is missing or not a site
+ */
+int gps_load_site(gpssite_s *site, const char *fname)
+{
+    FILE *fp;
+    int n;
+
+    fp = fopen(fname, "r");
+    if(fp == NULL) { return 0; }
+    n = fscanf(fp, "%lf %lf %lf %lf %lu", &site->latitude, &site->longitude, &site->altitude,
+               &site->precision, &site->fixes);
+    fclose(fp);
+
+    if(n != 5) { return 0; }
+    if(fabs(site->latitude) > 90.0 || fabs(site->longitude) > 180.0) { return 0; }
+
+    return 1;
+}
+
+/** \brief Write a surveyed site file
+ *
+ * \param gpssite_s structure, file name
+ * \return int 1 on success, 0 on failure
+ */
+int gps_save_site(const gpssite_s *site, const char *fname)
+{
+    FILE *fp;
+    int status;
+
+    fp = fopen(fname, "w");
+    if(fp == NULL) { return 0; }
+    fprintf(fp, "%.7f %.7f %.3f %.3f %lu\n", site->latitude, site->longitude, site->altitude,
+            site->precision, site->fixes);
+    fprintf(fp, "# latitude longitude altitude[m] precision[m] fixes\n");
+    status = (fclose(fp) == 0);
+
+    return status;
+}
 
 /** \brief Turn off GPS
  *
@@ -101,8 +713,12 @@ loc_t gps_location(void)
  */
 extern void gps_off(void)
 {
-    //Write off
-//    serial_close();
+    // Called from the ingestion thread itself when a survey locks
+    if(!pthread_equal(pthread_self(), gpsthread)) { gps_stop(); }
+#if !SIMGPS
+    serial_println(GPSSTANDBY, strlen(GPSSTANDBY));
+    serial_close();
+#endif
 }
 
 // Convert latitude and longitude to decimal from degree
@@ -128,25 +744,3 @@ double gps_deg_dec(double deg_point)
 
     return round(absdlat + (absmlat/60) + (absslat/3600)) /1000000;
 }
-
-/** \brief Open file in read mode, read in GPSBUFFERSZ strings into gpsbuffer
- *
- * \param string: filename
- * \return int 1
- * \author Thomas Aziz
- * \date 03APR2019
- */
-int StReadGPSData(char * fname)
-{
-    FILE * fp;
-    int i;
-    fp = fopen(fname,"r");
-    if(fp == NULL) { return 0; }
-    for(i = 0;i < GPSBUFFERSZ; i++)
-    {
-        fgets(gpsbuffer[i].msgstr,NMEAMSGSZ,fp);
-    }
-    fclose(fp);
-    return 1;
-}
-
@@ -8,10 +8,30 @@
 #define GPS_H
 
 #include "nmea.h"
+#include "ubx.h"
 
 #define SIMGPS 1
-#define GPSBUFFERSZ 20
+#define GPSUBX 0                // 1 reads u-blox UBX NAV-PVT/NAV-TIMEUTC instead of NMEA
 #define GPSDATASZ 256
+#define GPSREPLAYFILE "gpslog01.txt"    // simulated receiver log
+#define GPSUBXFILE "gpslog03.ubx"    // simulated receiver capture when GPSUBX is set
+#define GPSREPLAYWARP 1.0       // simulated receiver time warp, 1 is the recorded cadence
+#define GPSKNOTS 1.943844       // knots per m/s
+#define GPSFIXMAXAGE 5.0        // seconds before a published fix is treated as stale
+#define GPSFIXMAXHDOP 5.0       // horizontal DOP above which a fix is not used
+#define GPSSURVEY 1             // 1 averages fixes into a fixed site, then powers the GPS down
+#define GPSSITEFILE "site.txt"  // surveyed site, delete it to survey again
+#define GPSSURVEYINTERVAL 30.0  // seconds between averaged fixes, so their errors are less correlated
+#define GPSSURVEYMINFIXES 60    // fixes averaged before the precision is checked
+#define GPSSURVEYMINTIME 1800.0 // shortest survey before the site can lock [s]
+#define GPSSURVEYPRECISION 1.0  // standard error of the mean horizontal position to lock [m]
+#define GPSSTANDBY "$PMTK161,0*28"  // receiver standby command sent by gps_off()
+#define GPSRATEHZ 1             // fixes per second, 2 to 10 reconfigures the receiver at gps_init()
+#define GPSBAUD 9600            // receiver power-on speed, set by serial_config()
+#define GPSFASTBAUD 115200      // speed negotiated for GPSRATEHZ above 1
+#define GPSCONFIGWAIT 2000      // wait for a valid sentence at the new speed [ms]
+#define GPSLOCATIONWAIT 2000    // gps_location() wait for the ingestion thread's next fix [ms]
+#define GPSEARTHRADIUS 6371000.0    // mean earth radius [m]
 #define round(x) ((x < 0) ? (ceil((x)-0.5)) : (floor((x)+0.5)))
 
 
@@ -28,6 +48,46 @@ struct location
 
 typedef struct location loc_t;
 
+// Location being assembled from the sentences of one fix
+typedef struct gpsfill
+{
+    loc_t loc;
+    uint8_t status;         // NMEA_GPGGA, NMEA_GPRMC, ... bits seen
+    uint8_t quality;        // GPGGA fix quality
+    uint8_t satellites;     // GPGGA satellites in use
+    uint8_t fix;            // GPGSA 1 none, 2 2D, 3 3D, 0 until a GPGSA is seen
+    uint8_t visible;        // GPGSV satellites in view
+    double pdop;            // GPGSA dilution of precision, 0 until a GPGSA is seen
+    double hdop;
+    double vdop;
+    uint32_t itow;          // UBX GPS time of week of the last NAV-PVT [ms]
+} gpsfill_s;
+
+// Latest fix published by the ingestion thread
+typedef struct gpsfix
+{
+    loc_t loc;
+    uint8_t quality;        // 0 no fix, 1 GPS, 2 DGPS
+    uint8_t satellites;
+    uint8_t fix;            // GPGSA 1 none, 2 2D, 3 3D, 0 if the receiver sends no GPGSA
+    uint8_t visible;        // satellites in view
+    double pdop;            // dilution of precision, 0 if the receiver sends no GPGSA
+    double hdop;
+    double vdop;
+    double time;            // CLOCK_MONOTONIC seconds when published
+    unsigned long count;    // fixes published so far
+} gpsfix_s;
+
+// Site surveyed from averaged fixes
+typedef struct gpssite
+{
+    double latitude;        // decimal degrees
+    double longitude;
+    double altitude;        // metres above mean sea level
+    double precision;       // standard error of the mean horizontal position [m]
+    unsigned long fixes;    // fixes averaged
+} gpssite_s;
+
 // Initialize device
 extern void gps_init(void);
 
@@ -37,6 +97,20 @@ extern void gps_on(void);
 // Get the actual location
 loc_t gps_location(void);
 
+// Start and stop the background ingestion thread
+int gps_start(void);
+void gps_stop(void);
+
+// Copy the latest published fix, never blocks on the UART
+int gps_get_fix(gpsfix_s *);
+double gps_fix_age(const gpsfix_s *);
+int gps_fix_usable(const gpsfix_s *);
+
+// Surveyed site, 1 once it is locked and the GPS is powered down
+int gps_get_site(gpssite_s *);
+int gps_load_site(gpssite_s *, const char *);
+int gps_save_site(const gpssite_s *, const char *);
+
 
 // Turn off device (low-power consumption)
 extern void gps_off(void);
@@ -0,0 +1,255 @@
+/** \file gpsreplay.c
+ *  \brief Memory-mapped NMEA log replay
+ *
+ *  A log of any size is memory-mapped read only and indexed once: the offset and length of
+ *  every sentence and the UTC time of the sentences that carry one.  Players then hand out
+ *  pointers into the mapping, so nothing is copied, and pace them against the recorded
+ *  times at the original cadence, at a time warp, or not at all.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "nmea.h"
+#include "gpsreplay.h"
+
+#define GPSREPLAYGROW 65536     // index entries added at a time
+
+/** \brief Seconds on the monotonic clock
+ *
+ * \param void
+ * \return double seconds
+ */
+static double ReplayNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** \brief Read the UTC field (hhmmss.sss) of a sentence
+ *
+ * The time is field 1 of GGA, RMC, ZDA, GNS, GST and GBS sentences and field 5 of GLL.
+ *
+ * \param sentence starting at '$', length
+ * \return double UTC seconds of day, GPSNOTIME if the sentence has no time
+ */
+static double ReplayTime(const char *s, size_t len)
+{
+    const char *end = s + len;
+    const char *f;
+    uint32_t ms;
+    int field, want, digits;
+
+    if(len < 7) { return GPSNOTIME; }
+    if(memcmp(s + 3, "GGA", 3) == 0 || memcmp(s + 3, "RMC", 3) == 0 ||
+       memcmp(s + 3, "ZDA", 3) == 0 || memcmp(s + 3, "GNS", 3) == 0 ||
+       memcmp(s + 3, "GST", 3) == 0 || memcmp(s + 3, "GBS", 3) == 0)
+    {
+        want = 1;
+    }
+    else if(memcmp(s + 3, "GLL", 3) == 0)
+    {
+        want = 5;
+    }
+    else
+    {
+        return GPSNOTIME;
+    }
+
+    for(f = s, field = 0; f < end && field < want; f++)
+    {
+        if(*f == ',') { field++; }
+    }
+    if(field != want || end - f < 6) { return GPSNOTIME; }
+
+    for(digits = 0; digits < 6; digits++)
+    {
+        if(f[digits] < '0' || f[digits] > '9') { return GPSNOTIME; }
+    }
+    nmea_decode_time(f, end - f, &ms);
+
+    return ms / 1000.0;
+}
+
+/** \brief Memory-map an NMEA log and index its sentences
+ *
+ * \param gpsreplay_s structure, file name
+ * \return int 1 on success, 0 on failure
+ */
+int gpsreplay_open(gpsreplay_s *replay, const char *fname)
+{
+    struct stat st;
+    const char *p, *end, *nl;
+    size_t cap = 0, len;
+    void *map, *grow;
+    int fd;
+
+    memset(replay, 0, sizeof(*replay));
+    fd = open(fname, O_RDONLY);
+    if(fd < 0) { return 0; }
+    if(fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) { return 0; }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    replay->map = (const char *)map;
+    replay->maplen = st.st_size;
+
+    p = replay->map;
+    end = p + replay->maplen;
+    while(p < end)
+    {
+        nl = (const char *)memchr(p, '\n', end - p);
+        if(nl == NULL) { nl = end; }
+
+        if(*p == '$')
+        {
+            len = nl - p;
+            if(len > 0 && p[len - 1] == '\r') { len--; }
+
+            if(replay->count == cap)
+            {
+                // Each array keeps its old block until its realloc succeeds, so a failure
+                // leaves everything for gpsreplay_close() to free and unmap
+                cap += GPSREPLAYGROW;
+                grow = realloc(replay->offset, cap * sizeof(size_t));
+                if(grow == NULL) { gpsreplay_close(replay); return 0; }
+                replay->offset = (size_t *)grow;
+                grow = realloc(replay->length, cap * sizeof(size_t));
+                if(grow == NULL) { gpsreplay_close(replay); return 0; }
+                replay->length = (size_t *)grow;
+                grow = realloc(replay->utc, cap * sizeof(double));
+                if(grow == NULL) { gpsreplay_close(replay); return 0; }
+                replay->utc = (double *)grow;
+            }
+            replay->offset[replay->count] = p - replay->map;
+            replay->length[replay->count] = len;
+            replay->utc[replay->count] = ReplayTime(p, len);
+            replay->count++;
+        }
+        p = nl + 1;
+    }
+
+    if(replay->count == 0)
+    {
+        gpsreplay_close(replay);
+        return 0;
+    }
+
+    return 1;
+}
+
+/** \brief Release the index and unmap the log
+ *
+ * \param gpsreplay_s structure
+ * \return void
+ */
+void gpsreplay_close(gpsreplay_s *replay)
+{
+    if(replay->map != NULL) { munmap((void *)replay->map, replay->maplen); }
+    free(replay->offset);
+    free(replay->length);
+    free(replay->utc);
+    memset(replay, 0, sizeof(*replay));
+}
+
+/** \brief Prepare a player at the start of an indexed log
+ *
+ * \param gpsplayer_s structure, indexed log, time warp (1 recorded cadence, GPSWARPFAST none),
+ *        non-zero to restart at the end of the log
+ * \return void
+ */
+void gpsplayer_init(gpsplayer_s *player, const gpsreplay_s *replay, double warp, int loop)
+{
+    memset(player, 0, sizeof(*player));
+    player->replay = replay;
+    player->warp = warp;
+    player->loop = loop;
+    player->utcstart = GPSNOTIME;
+    player->utclast = GPSNOTIME;
+}
+
+/** \brief Get the next sentence, waiting until it is due at the player's time warp
+ *
+ * \param gpsplayer_s structure, returned sentence length (without the line end)
+ * \return const char* sentence inside the mapped log, NULL at the end of the log
+ */
+const char *gpsplayer_next(gpsplayer_s *player, size_t *len)
+{
+    const gpsreplay_s *replay = player->replay;
+    struct timespec ts;
+    double utc, due, wait;
+    size_t i;
+
+    if(player->next >= replay->count)
+    {
+        if(!player->loop) { return NULL; }
+        gpsplayer_init(player, replay, player->warp, player->loop);
+    }
+
+    i = player->next++;
+    utc = replay->utc[i];
+
+    if(player->warp > 0.0 && utc != GPSNOTIME)
+    {
+        if(player->utclast != GPSNOTIME && utc + player->dayoffset < player->utclast - 43200.0)
+        {
+            player->dayoffset += 86400.0;
+        }
+        utc += player->dayoffset;
+        player->utclast = utc;
+
+        if(player->utcstart == GPSNOTIME)
+        {
+            player->utcstart = utc;
+            player->wallstart = ReplayNow();
+        }
+        else
+        {
+            due = player->wallstart + (utc - player->utcstart) / player->warp;
+            wait = due - ReplayNow();
+            if(wait > 0.0)
+            {
+                ts.tv_sec = (time_t)wait;
+                ts.tv_nsec = (long)((wait - ts.tv_sec) * 1e9);
+                nanosleep(&ts, NULL);
+            }
+        }
+    }
+
+    *len = replay->length[i];
+    return replay->map + replay->offset[i];
+}
+
+/** \brief Play sentences into a streaming parser
+ *
+ * \param gpsplayer_s structure, nmeastream_t structure, maximum number of sentences
+ * \return size_t number of sentences played, less than max at the end of the log
+ */
+size_t gpsplayer_feed(gpsplayer_s *player, nmeastream_t *stream, size_t max)
+{
+    const char *sentence;
+    size_t len, played;
+
+    for(played = 0; played < max; played++)
+    {
+        sentence = gpsplayer_next(player, &len);
+        if(sentence == NULL) { break; }
+        nmea_stream_feed(stream, sentence, len);
+    }
+
+    return played;
+}
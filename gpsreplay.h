@@ -0,0 +1,45 @@
+/** \file gpsreplay.h
+ *  \brief Memory-mapped NMEA log replay - header
+*/
+
+#ifndef GPSREPLAY_H
+#define GPSREPLAY_H
+
+#include <stddef.h>
+#include "nmea.h"
+
+#define GPSWARPFAST 0.0         // warp value that plays back as fast as possible
+#define GPSNOTIME -1.0          // sentence without a UTC field
+
+// Indexed log, read only after gpsreplay_open() so several players can share it
+typedef struct gpsreplay
+{
+    const char *map;            // mapped file
+    size_t maplen;
+    size_t *offset;             // start of each sentence ('$')
+    size_t *length;             // sentence length without the line end
+    double *utc;                // UTC seconds of day, GPSNOTIME when the sentence has none
+    size_t count;               // sentences indexed
+} gpsreplay_s;
+
+// Playback position and pacing over a gpsreplay_s
+typedef struct gpsplayer
+{
+    const gpsreplay_s *replay;
+    size_t next;                // next sentence index
+    double warp;                // 1 recorded cadence, N times faster, GPSWARPFAST no pacing
+    int loop;                   // restart at the end of the log
+    double wallstart;           // monotonic seconds when the first timed sentence played
+    double utcstart;            // log time of that sentence (days unwrapped)
+    double utclast;             // last log time seen, to detect midnight
+    double dayoffset;           // seconds added after each midnight
+} gpsplayer_s;
+
+// Function Prototypes
+int gpsreplay_open(gpsreplay_s *replay, const char *fname);
+void gpsreplay_close(gpsreplay_s *replay);
+void gpsplayer_init(gpsplayer_s *player, const gpsreplay_s *replay, double warp, int loop);
+const char *gpsplayer_next(gpsplayer_s *player, size_t *len);
+size_t gpsplayer_feed(gpsplayer_s *player, nmeastream_t *stream, size_t max);
+
+#endif // GPSREPLAY_H
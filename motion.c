@@ -0,0 +1,440 @@
+/** \file motion.c
+ *  \brief Real-time stepper motion thread
+ *
+ *  Moves are handed to a dedicated thread that issues every step pulse at an absolute
+ *  CLOCK_MONOTONIC deadline with clock_nanosleep(), so timing errors do not accumulate
+ *  over a move and the caller returns at once.  Step intervals follow a trapezoidal
+ *  profile, ramping from a start rate the motor can pull in from standstill to the slew
+ *  rate and back down.
+ *
+ *  An attached servo moves in the same thread, at the same time as the stepper.  Either
+ *  its PWM is written at the start and the move ends when the slower axis has arrived, or
+ *  the move is synchronised: the PWM is ramped one servo frame at a time and the slower
+ *  axis sets the pace of the other, so both arrive together.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <wiringPi.h>
+#include "motion.h"
+
+static motionprofile_s mtprofile;
+static motionservo_s mtservo;
+static int mtsteppin, mtdirpin;
+static int mtservoattached = 0;
+static int mtsync = 0;              // synchronise the pending move
+static motionstatus_s mtstatus;
+static pthread_t mtthread;
+static int mtrunning = 0;
+static pthread_mutex_t mtlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mtwake = PTHREAD_COND_INITIALIZER;    // new target or stopping
+static pthread_cond_t mtidle = PTHREAD_COND_INITIALIZER;    // target reached
+
+/** \brief Time between two steps of a move
+ *
+ * The rate at a step is the lowest of the slew rate, the rate reached accelerating from the
+ * start of the move and the rate from which the end of the move can still be reached,
+ * v = sqrt(v0^2 + 2 a s), which makes the ramps symmetric.
+ *
+ * \param motionprofile_s structure, step index i, steps in the move
+ * \return double seconds between step i and step i+1
+ */
+double motion_step_interval(const motionprofile_s *p, long i, long steps)
+{
+    double v0 = p->startrate * p->startrate;
+    double up = sqrt(v0 + 2.0 * p->accel * (i + 1));
+    double down = sqrt(v0 + 2.0 * p->accel * (steps - 1 - i));
+    double rate = p->maxrate;
+
+    if(up < rate) { rate = up; }
+    if(down < rate) { rate = down; }
+
+    return 1.0 / rate;
+}
+
+/** \brief Duration of a move from its first to its last step
+ *
+ * \param motionprofile_s structure, steps in the move
+ * \return double seconds
+ */
+double motion_duration(const motionprofile_s *p, long steps)
+{
+    double t = 0.0;
+    long i;
+
+    for(i = 0; i < steps - 1; i++) { t += motion_step_interval(p, i, steps); }
+
+    return t;
+}
+
+/** \brief Time for the servo to travel between two PWM values
+ *
+ * \param motionservo_s structure, PWM from (MOTIONNOPWM assumes the full travel), PWM to
+ * \return double seconds, 0 if the PWM does not change
+ */
+double motion_servo_duration(const motionservo_s *servo, int from, int to)
+{
+    double t;
+
+    if(from == to) { return 0.0; }
+    if(from == MOTIONNOPWM) { return servo->travel; }
+
+    t = servo->travel * abs(to - from) / servo->range;
+    if(t < MOTIONSERVOMS / 1000.0) { t = MOTIONSERVOMS / 1000.0; }
+
+    return t;
+}
+
+/** \brief Advance an absolute deadline
+ *
+ * \param timespec deadline, seconds to add
+ * \return void
+ */
+static void MotionAdd(struct timespec *ts, double seconds)
+{
+    long ns = (long)(seconds * 1e9);
+
+    ts->tv_sec += ns / 1000000000L;
+    ts->tv_nsec += ns % 1000000000L;
+    if(ts->tv_nsec >= 1000000000L)
+    {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+/** \brief Seconds from one time to another
+ *
+ * \param timespec from, timespec to
+ * \return double seconds, negative if to is earlier
+ */
+static double MotionElapsed(const struct timespec *from, const struct timespec *to)
+{
+    return (to->tv_sec - from->tv_sec) + (to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+/** \brief Sleep until an absolute deadline
+ *
+ * \param timespec deadline
+ * \return void
+ */
+static void MotionSleepUntil(const struct timespec *deadline)
+{
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL) == EINTR) { }
+}
+
+/** \brief Run one move of both axes
+ *
+ * Step and servo frame deadlines are merged, the thread sleeps until the earlier one.
+ *
+ * \param steps, direction (1 or -1), servo PWM from and to, non-zero to synchronise
+ * \return int 1 when both axes have arrived, 0 if the thread was stopped during the move
+ */
+static int MotionExecute(long steps, int dir, int pwm0, int pwm1, int sync)
+{
+    struct timespec start, now, stepdl, servodl, settle;
+    double tstep, tservo, scale = 1.0, total, late, frac;
+    int ramp, pwm, running = 1;
+    long i = 0;
+
+    tstep = motion_duration(&mtprofile, steps);
+    tservo = (mtservoattached) ? motion_servo_duration(&mtservo, pwm0, pwm1) : 0.0;
+    ramp = sync && tservo > 0.0 && pwm0 != MOTIONNOPWM;
+
+    // A synchronised move stretches the faster axis over the time of the slower one
+    if(sync && steps > 1 && tservo > tstep) { scale = tservo / tstep; }
+    total = (tstep * scale > tservo) ? tstep * scale : tservo;
+
+    if(tservo > 0.0 && !ramp)
+    {
+        pwmWrite(mtservo.pin, pwm1);
+        pthread_mutex_lock(&mtlock);
+        mtstatus.pwm = pwm1;
+        pthread_mutex_unlock(&mtlock);
+    }
+    if(steps > 0)
+    {
+        digitalWrite(mtdirpin, (dir > 0) ? HIGH : LOW);
+        delayMicroseconds(MOTIONPULSEUS);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    stepdl = servodl = settle = start;
+    MotionAdd(&settle, tservo);
+
+    while(running && (i < steps || ramp))
+    {
+        // Next event, a step or a servo frame, whichever is due first
+        if(i < steps && (!ramp || MotionElapsed(&stepdl, &servodl) >= 0.0))
+        {
+            MotionSleepUntil(&stepdl);
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            digitalWrite(mtsteppin, HIGH);
+            delayMicroseconds(MOTIONPULSEUS);
+            digitalWrite(mtsteppin, LOW);
+
+            late = MotionElapsed(&stepdl, &now) * 1e6;
+            pthread_mutex_lock(&mtlock);
+            mtstatus.position += dir;
+            mtstatus.steps++;
+            if(late > MOTIONLATEUS) { mtstatus.late++; }
+            if(late > mtstatus.maxlateus) { mtstatus.maxlateus = late; }
+            running = mtrunning;
+            pthread_mutex_unlock(&mtlock);
+
+            i++;
+            if(i < steps) { MotionAdd(&stepdl, motion_step_interval(&mtprofile, i - 1, steps) * scale); }
+        }
+        else
+        {
+            MotionSleepUntil(&servodl);
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            frac = MotionElapsed(&start, &now) / total;
+            if(frac >= 1.0)
+            {
+                frac = 1.0;
+                ramp = 0;
+            }
+            pwm = pwm0 + (int)lround((pwm1 - pwm0) * frac);
+            pwmWrite(mtservo.pin, pwm);
+
+            pthread_mutex_lock(&mtlock);
+            mtstatus.pwm = pwm;
+            running = mtrunning;
+            pthread_mutex_unlock(&mtlock);
+
+            MotionAdd(&servodl, MOTIONSERVOMS / 1000.0);
+        }
+    }
+
+    // A servo written at the start is still travelling after a short stepper move
+    if(running && tservo > 0.0) { MotionSleepUntil(&settle); }
+
+    return running;
+}
+
+/** \brief Motion thread, runs each move to its target at the profile's step deadlines
+ *
+ * A target changed during a move is picked up once the move ends.
+ *
+ * \param unused
+ * \return NULL
+ */
+static void *MotionRun(void *arg)
+{
+    struct timespec start, now;
+    long steps;
+    int pwm0, pwm1, sync;
+
+    (void)arg;
+    pthread_mutex_lock(&mtlock);
+    while(mtrunning)
+    {
+        if(mtstatus.position == mtstatus.target && mtstatus.pwm == mtstatus.pwmtarget)
+        {
+            mtstatus.busy = 0;
+            pthread_cond_broadcast(&mtidle);
+            pthread_cond_wait(&mtwake, &mtlock);
+            continue;
+        }
+
+        steps = mtstatus.target - mtstatus.position;
+        pwm0 = mtstatus.pwm;
+        pwm1 = mtstatus.pwmtarget;
+        sync = mtsync;
+        pthread_mutex_unlock(&mtlock);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        MotionExecute(labs(steps), (steps > 0) ? 1 : -1, pwm0, pwm1, sync);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        pthread_mutex_lock(&mtlock);
+        mtstatus.lastduration = MotionElapsed(&start, &now);
+        mtstatus.moves++;
+    }
+    mtstatus.busy = 0;
+    pthread_cond_broadcast(&mtidle);
+    pthread_mutex_unlock(&mtlock);
+
+    return NULL;
+}
+
+/** \brief Start the motion thread for one stepper
+ *
+ * \param step pin, direction pin, motionprofile_s structure
+ * \return int 1 on success, 0 on failure
+ */
+int motion_start(int steppin, int dirpin, const motionprofile_s *profile)
+{
+    pthread_attr_t attr;
+    struct sched_param param;
+    int status;
+
+    if(mtrunning) { return 1; }
+    if(profile->startrate <= 0.0 || profile->maxrate < profile->startrate || profile->accel <= 0.0) { return 0; }
+
+    mtprofile = *profile;
+    mtsteppin = steppin;
+    mtdirpin = dirpin;
+    memset(&mtstatus, 0, sizeof(mtstatus));
+    mtstatus.pwm = mtstatus.pwmtarget = (mtservoattached) ? mtservo.pwm : MOTIONNOPWM;
+    mtrunning = 1;
+
+    // Real-time priority keeps the step deadlines when the GUI is busy, it needs privileges
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    param.sched_priority = MOTIONPRIORITY;
+    pthread_attr_setschedparam(&attr, &param);
+    status = pthread_create(&mtthread, &attr, MotionRun, NULL);
+    pthread_attr_destroy(&attr);
+    if(status != 0) { status = pthread_create(&mtthread, NULL, MotionRun, NULL); }
+    if(status != 0)
+    {
+        mtrunning = 0;
+        return 0;
+    }
+
+    return 1;
+}
+
+/** \brief Stop the motion thread, a move in progress ends at the next step
+ *
+ * \param void
+ * \return void
+ */
+void motion_stop(void)
+{
+    pthread_mutex_lock(&mtlock);
+    if(!mtrunning)
+    {
+        pthread_mutex_unlock(&mtlock);
+        return;
+    }
+    mtrunning = 0;
+    pthread_cond_broadcast(&mtwake);
+    pthread_mutex_unlock(&mtlock);
+
+    pthread_join(mtthread, NULL);
+}
+
+/** \brief Attach a servo to move together with the stepper, before motion_start()
+ *
+ * \param motionservo_s structure
+ * \return int 1 on success, 0 if the thread is already running or the servo is invalid
+ */
+int motion_attach_servo(const motionservo_s *servo)
+{
+    if(mtrunning || servo->range <= 0.0 || servo->travel < 0.0) { return 0; }
+
+    mtservo = *servo;
+    mtservoattached = 1;
+
+    return 1;
+}
+
+/** \brief Queue a move of both axes, returns without waiting for it
+ *
+ * Without sync the servo PWM is written at the start and the move ends when the slower
+ * axis has arrived.  With sync the servo is ramped and the faster axis slowed down so
+ * that both arrive together.
+ *
+ * \param steps (positive in the HIGH direction), servo PWM target, non-zero to synchronise
+ * \return int 1 if queued, 0 if the thread is not running
+ */
+int motion_move_axes(long steps, int pwm, int sync)
+{
+    pthread_mutex_lock(&mtlock);
+    if(!mtrunning)
+    {
+        pthread_mutex_unlock(&mtlock);
+        return 0;
+    }
+    mtstatus.target += steps;
+    if(mtservoattached) { mtstatus.pwmtarget = pwm; }
+    mtsync = sync;
+    if(mtstatus.target != mtstatus.position || mtstatus.pwmtarget != mtstatus.pwm) { mtstatus.busy = 1; }
+    pthread_cond_signal(&mtwake);
+    pthread_mutex_unlock(&mtlock);
+
+    return 1;
+}
+
+/** \brief Queue a relative stepper move, returns without waiting for it
+ *
+ * \param steps, positive in the HIGH direction
+ * \return int 1 if queued, 0 if the thread is not running
+ */
+int motion_move(long steps)
+{
+    int pwm;
+
+    pthread_mutex_lock(&mtlock);
+    pwm = mtstatus.pwmtarget;
+    pthread_mutex_unlock(&mtlock);
+
+    return motion_move_axes(steps, pwm, 0);
+}
+
+/** \brief Check for a move in progress or pending
+ *
+ * \param void
+ * \return int 1 if the stepper is moving, 0 if it is at its target
+ */
+int motion_busy(void)
+{
+    int busy;
+
+    pthread_mutex_lock(&mtlock);
+    busy = mtstatus.busy;
+    pthread_mutex_unlock(&mtlock);
+
+    return busy;
+}
+
+/** \brief Wait for the stepper to reach its target
+ *
+ * \param timeout in milliseconds (negative waits forever)
+ * \return int 1 once at the target, 0 on timeout
+ */
+int motion_wait(int timeout)
+{
+    struct timespec deadline;
+    int busy;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    MotionAdd(&deadline, timeout / 1000.0);
+
+    pthread_mutex_lock(&mtlock);
+    while(mtstatus.busy)
+    {
+        if(timeout < 0) { pthread_cond_wait(&mtidle, &mtlock); }
+        else if(pthread_cond_timedwait(&mtidle, &mtlock, &deadline) != 0) { break; }
+    }
+    busy = mtstatus.busy;
+    pthread_mutex_unlock(&mtlock);
+
+    return !busy;
+}
+
+/** \brief Copy the motion counters
+ *
+ * \param void
+ * \return motionstatus_s structure
+ */
+motionstatus_s motion_get_status(void)
+{
+    motionstatus_s status;
+
+    pthread_mutex_lock(&mtlock);
+    status = mtstatus;
+    pthread_mutex_unlock(&mtlock);
+
+    return status;
+}
@@ -0,0 +1,58 @@
+/** \file motion.h
+ *  \brief Real-time stepper motion thread - header
+*/
+
+#ifndef MOTION_H
+#define MOTION_H
+
+#define MOTIONPULSEUS   5       // step pulse high time, also the direction setup time [us]
+#define MOTIONPRIORITY  50      // SCHED_FIFO priority, falls back to the default policy without permission
+#define MOTIONLATEUS    200     // a step this far behind its deadline counts as late [us]
+#define MOTIONSERVOMS   20      // servo PWM update period of a synchronised move, one servo frame [ms]
+#define MOTIONNOPWM     -1      // servo position not known yet
+
+/** Trapezoidal profile: ramp up from the start rate at a constant acceleration, cruise at
+ *  the maximum rate, ramp down symmetrically.  Short moves never reach the cruise rate. */
+typedef struct motionprofile
+{
+    double startrate;       ///< rate of the first and last step [steps/s]
+    double maxrate;         ///< slew rate [steps/s]
+    double accel;           ///< acceleration and deceleration [steps/s^2]
+} motionprofile_s;
+
+/** Positional servo driven by PWM, it travels by itself once the PWM is written */
+typedef struct motionservo
+{
+    int pin;                ///< PWM pin
+    int pwm;                ///< current PWM value, MOTIONNOPWM if unknown
+    double range;           ///< PWM span of the full travel
+    double travel;          ///< time for the full travel [s]
+} motionservo_s;
+
+typedef struct motionstatus
+{
+    int busy;               ///< a move is in progress or pending
+    long position;          ///< steps taken since motion_start(), signed by direction
+    long target;            ///< position being moved to
+    int pwm;                ///< servo PWM written last, MOTIONNOPWM without a servo
+    int pwmtarget;          ///< servo PWM being moved to
+    unsigned long moves;    ///< moves completed
+    unsigned long steps;    ///< steps taken in total
+    double lastduration;    ///< duration of the last move [s]
+    unsigned long late;     ///< steps issued more than MOTIONLATEUS after their deadline
+    double maxlateus;       ///< worst step lateness [us]
+} motionstatus_s;
+
+int motion_start(int, int, const motionprofile_s *);
+void motion_stop(void);
+int motion_attach_servo(const motionservo_s *);
+int motion_move(long);
+int motion_move_axes(long, int, int);
+int motion_busy(void);
+int motion_wait(int);
+motionstatus_s motion_get_status(void);
+double motion_step_interval(const motionprofile_s *, long, long);
+double motion_duration(const motionprofile_s *, long);
+double motion_servo_duration(const motionservo_s *, int, int);
+
+#endif
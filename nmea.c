@@ -25,9 +25,11 @@ void nmea_parse_gpgga(char *nmea, gpgga_t *loc)
 
     p = strchr(p, ',')+1; // time
 	loc->utc = atof(p);
+    nmea_decode_time(p, NMEAMSGSZ, &loc->utcms);
 
     p = strchr(p, ',')+1;
     loc->latitude = atof(p);
+    nmea_decode_coord(p, NMEAMSGSZ, &loc->latmicro);
 
     p = strchr(p, ',')+1;
     switch (p[0])
@@ -42,9 +44,11 @@ void nmea_parse_gpgga(char *nmea, gpgga_t *loc)
             loc->lat = '\0';
             break;
     }
+    if(loc->lat == 'S') { loc->latmicro = -loc->latmicro; }
 
     p = strchr(p, ',')+1;
     loc->longitude = atof(p);
+    nmea_decode_coord(p, NMEAMSGSZ, &loc->lonmicro);
 
     p = strchr(p, ',')+1;
     switch (p[0])
@@ -59,6 +63,7 @@ void nmea_parse_gpgga(char *nmea, gpgga_t *loc)
             loc->lon = '\0';
             break;
     }
+    if(loc->lon == 'W') { loc->lonmicro = -loc->lonmicro; }
 
     p = strchr(p, ',')+1;
     loc->quality = (uint8_t)atoi(p);
@@ -83,10 +88,12 @@ void nmea_parse_gprmc(char *nmea, gprmc_t *loc)
 {
     char *p = nmea;
 
-    p = strchr(p, ',')+1; // skip time
+    p = strchr(p, ',')+1; // time
+    nmea_decode_time(p, NMEAMSGSZ, &loc->utcms);
 	p = strchr(p, ',')+1; //skip status
     p = strchr(p, ',')+1;
     loc->latitude = atof(p);
+    nmea_decode_coord(p, NMEAMSGSZ, &loc->latmicro);
     p = strchr(p, ',')+1;
     switch (p[0])
 	{
@@ -100,9 +107,11 @@ void nmea_parse_gprmc(char *nmea, gprmc_t *loc)
             loc->lat = '\0';
             break;
     }
+    if(loc->lat == 'S') { loc->latmicro = -loc->latmicro; }
 
     p = strchr(p, ',')+1;
     loc->longitude = atof(p);
+    nmea_decode_coord(p, NMEAMSGSZ, &loc->lonmicro);
     p = strchr(p, ',')+1;
     switch (p[0])
 	{
@@ -116,6 +125,7 @@ void nmea_parse_gprmc(char *nmea, gprmc_t *loc)
             loc->lon = '\0';
             break;
     }
+    if(loc->lon == 'W') { loc->lonmicro = -loc->lonmicro; }
 
     p = strchr(p, ',')+1;
     loc->speed = atof(p);
@@ -125,39 +135,1015 @@ void nmea_parse_gprmc(char *nmea, gprmc_t *loc)
 
     p = strchr(p, ',')+1;
     loc->date = atof(p);
+    nmea_decode_date(p, NMEAMSGSZ, &loc->datedmy);
 }
 
 /**
- * Get the message type (GPGGA, GPRMC, etc..)
+ * Get the message type (GPGGA, GPRMC, GPGSA, GPGSV, GPGLL, GPVTG)
  *
- * This function filters out also wrong packages (invalid checksum)
+ * This function filters out also wrong packages (invalid checksum).  The type comes from
+ * the dispatch table, any supported talker is accepted.
  *
  * @param message The NMEA message
  * @return The type of message if it is valid
  */
 uint8_t nmea_get_message_type(const char *message)
 {
-    uint8_t checksum = 0;
-    if ((checksum = nmea_valid_checksum(message)) != _EMPTY){ return checksum; }
-
-    if (strstr(message, NMEA_GPGGA_STR) != NULL) { return NMEA_GPGGA; }
+    nmeascan_t scan;
 
-    if (strstr(message, NMEA_GPRMC_STR) != NULL) { return NMEA_GPRMC; }
+    nmea_scan(message, strlen(message), &scan);
+    if (!scan.valid) { return NMEA_CHECKSUM_ERR; }
 
-    return NMEA_UNKNOWN;
+    return nmea_scan_type(message, &scan);
 }
 
 uint8_t nmea_valid_checksum(const char *message)
 {
-    uint8_t checksum= (uint8_t)strtol(strchr(message, '*')+1, NULL, 16);
+    nmeascan_t scan;
+
+    nmea_scan(message, strlen(message), &scan);
+    if (!scan.valid) { return NMEA_CHECKSUM_ERR; }
+
+    return _EMPTY;
+}
+
+
+static const double nmeapow10[NMEAMAXFRAC+1] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15
+};
+
+static const uint64_t nmeapow10i[NMEAMAXFRAC+1] =
+{
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+    10000000000000ULL, 100000000000000ULL, 1000000000000000ULL
+};
+
+/** \brief Convert a ddmm.mmmm digit string to micro-degrees in integer arithmetic
+ *
+ * The whole minutes and their decimals are kept as one integer scaled by 10^frac, so the
+ * only rounding is the final one to the nearest micro-degree (half away from zero), the
+ * result gps_deg_dec() aims for through doubles.
+ *
+ * \param digits without the decimal point, number of decimals (-1 if there was no point)
+ * \return int32_t unsigned coordinate in micro-degrees
+ */
+static int32_t NmeaMicroDegrees(uint64_t mantissa, int frac)
+{
+    uint64_t scale, degrees, minutes;
+
+    if(frac < 0) { frac = 0; }
+    for(; frac > NMEACOORDFRAC; frac--) { mantissa /= 10; }
+
+    scale = nmeapow10i[frac];
+    degrees = mantissa / (100 * scale);
+    minutes = mantissa - degrees * 100 * scale;
+
+    return (int32_t)(degrees * NMEAMICRO + (minutes * NMEAMICRO + 30 * scale) / (60 * scale));
+}
+
+/** \brief Convert a hhmmss.sss digit string to milliseconds of the day
+ *
+ * \param digits without the decimal point, number of decimals (-1 if there was no point)
+ * \return uint32_t milliseconds, the fraction rounded to the nearest millisecond
+ */
+static uint32_t NmeaMilliseconds(uint64_t mantissa, int frac)
+{
+    uint64_t scale = nmeapow10i[(frac < 0) ? 0 : frac];
+    uint64_t whole = mantissa / scale;
+    uint64_t part = mantissa - whole * scale;
+
+    return (uint32_t)((whole / 10000) * 3600000 + (whole / 100 % 100) * 60000 +
+                      (whole % 100) * 1000 + (part * 1000 + scale / 2) / scale);
+}
+
+/** \brief Accumulate the digits of an unsigned decimal field
+ *
+ * Stops at the first character that is not a digit or the decimal point, so the field can
+ * be followed by ',', '*' or the end of a string.  No libc conversion is involved.
+ *
+ * \param field, maximum number of characters, returned digits, returned decimals
+ * \return int 1 if the field has digits, 0 if it is empty
+ */
+static int NmeaDecimal(const char *p, size_t len, uint64_t *mantissa, int *frac)
+{
+    const char *end = p + len;
+    int digits = 0;
+
+    *mantissa = 0;
+    *frac = -1;
+    for(; p < end; p++)
+    {
+        if(*p >= '0' && *p <= '9')
+        {
+            if(*frac < NMEAMAXFRAC)
+            {
+                *mantissa = *mantissa * 10 + (uint64_t)(*p - '0');
+                if(*frac >= 0) { (*frac)++; }
+            }
+            digits++;
+        }
+        else if(*p == '.' && *frac < 0)
+        {
+            *frac = 0;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return digits > 0;
+}
+
+/** \brief Decode a ddmm.mmmm or dddmm.mmmm coordinate field to micro-degrees
+ *
+ * \param field, maximum number of characters, returned unsigned micro-degrees (0 if empty)
+ * \return int 1 on success, 0 if the field is empty
+ */
+int nmea_decode_coord(const char *field, size_t len, int32_t *micro)
+{
+    uint64_t mantissa;
+    int frac;
+
+    *micro = 0;
+    if(!NmeaDecimal(field, len, &mantissa, &frac)) { return 0; }
+    *micro = NmeaMicroDegrees(mantissa, frac);
+
+    return 1;
+}
+
+/** \brief Decode a hhmmss.sss time field to milliseconds of the day
+ *
+ * \param field, maximum number of characters, returned milliseconds (0 if empty)
+ * \return int 1 on success, 0 if the field is empty
+ */
+int nmea_decode_time(const char *field, size_t len, uint32_t *ms)
+{
+    uint64_t mantissa;
+    int frac;
+
+    *ms = 0;
+    if(!NmeaDecimal(field, len, &mantissa, &frac)) { return 0; }
+    *ms = NmeaMilliseconds(mantissa, frac);
+
+    return 1;
+}
+
+/** \brief Decode a ddmmyy date field to an integer
+ *
+ * \param field, maximum number of characters, returned ddmmyy (0 if empty)
+ * \return int 1 on success, 0 if the field is empty
+ */
+int nmea_decode_date(const char *field, size_t len, uint32_t *dmy)
+{
+    uint64_t mantissa;
+    int frac;
 
-    char p;
+    *dmy = 0;
+    if(!NmeaDecimal(field, len, &mantissa, &frac)) { return 0; }
+    *dmy = (uint32_t)(mantissa / nmeapow10i[(frac < 0) ? 0 : frac]);
+
+    return 1;
+}
+
+/** \brief Convert a hexadecimal checksum digit
+ *
+ * \param character
+ * \return int digit value, -1 if not a hexadecimal digit
+ */
+static int NmeaHexDigit(char c)
+{
+    if(c >= '0' && c <= '9') { return c - '0'; }
+    if(c >= 'A' && c <= 'F') { return c - 'A' + 10; }
+    if(c >= 'a' && c <= 'f') { return c - 'a' + 10; }
+    return -1;
+}
+
+typedef size_t (*nmea_scan_kernel)(const char *s, size_t len, nmeascan_t *scan);
+
+/** \brief Record the fields that start after a mask of comma positions
+ *
+ * \param nmeascan_t structure, one bit per comma, offset of bit 0 in the sentence
+ * \return void
+ */
+static void NmeaScanCommas(nmeascan_t *scan, unsigned mask, size_t base)
+{
+    while(mask != 0 && scan->fields < NMEAMAXFIELDS)
+    {
+        scan->field[scan->fields++] = (uint16_t)(base + __builtin_ctz(mask) + 1);
+        mask &= mask - 1;
+    }
+}
+
+/** \brief Portable scanner, one character at a time
+ *
+ * \param sentence starting at '$', length, nmeascan_t structure with field 0 set
+ * \return size_t offset of the '*' or line end, len if there is none
+ */
+static size_t NmeaScanScalar(const char *s, size_t len, nmeascan_t *scan)
+{
     uint8_t sum = 0;
-    ++message;
-    while ((p = *message++) != '*') { sum ^= p; }
+    size_t i;
+    char c;
 
-    if (sum != checksum) { return NMEA_CHECKSUM_ERR; }
+    for(i = 1; i < len; i++)
+    {
+        c = s[i];
+        if(c == '*' || c == '\r' || c == '\n') { break; }
+        if(c == ',' && scan->fields < NMEAMAXFIELDS) { scan->field[scan->fields++] = (uint16_t)(i + 1); }
+        sum ^= (uint8_t)c;
+    }
+    scan->sum = sum;
 
-    return _EMPTY;
+    return i;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/** \brief AVX2 scanner, 32 characters per compare
+ *
+ * Each block is compared against ',', '*', CR and LF at once.  The block holding the
+ * terminator is masked to the characters before it, so the XOR and the comma positions both
+ * come from the same loads.  A short last block is copied into a zero-padded buffer, so no
+ * byte past len is read; zero bytes leave the XOR unchanged.
+ *
+ * \param sentence starting at '$', length, nmeascan_t structure with field 0 set
+ * \return size_t offset of the '*' or line end, len if there is none
+ */
+__attribute__((target("avx2")))
+static size_t NmeaScanAvx2(const char *s, size_t len, nmeascan_t *scan)
+{
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i star  = _mm256_set1_epi8('*');
+    const __m256i cr    = _mm256_set1_epi8('\r');
+    const __m256i lf    = _mm256_set1_epi8('\n');
+    const __m256i index = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                           16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28,
+                                           29, 30, 31);
+    __m256i acc = _mm256_setzero_si256();
+    __m256i v;
+    __m128i x;
+    char tail[32];
+    unsigned term, commas;
+    size_t i, stop = len;
+    int bit;
+
+    for(i = 1; i < len; i += 32)
+    {
+        if(len - i >= 32)
+        {
+            v = _mm256_loadu_si256((const __m256i *)(s + i));
+        }
+        else
+        {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, s + i, len - i);
+            v = _mm256_loadu_si256((const __m256i *)tail);
+        }
+        term = (unsigned)_mm256_movemask_epi8(_mm256_or_si256(
+                   _mm256_cmpeq_epi8(v, star),
+                   _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf))));
+        commas = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, comma));
+        if(term != 0)
+        {
+            bit = __builtin_ctz(term);
+            commas &= (1u << bit) - 1;
+            v = _mm256_and_si256(v, _mm256_cmpgt_epi8(_mm256_set1_epi8((char)bit), index));
+            stop = i + bit;
+        }
+        acc = _mm256_xor_si256(acc, v);
+        NmeaScanCommas(scan, commas, i);
+        if(term != 0) { break; }
+    }
+
+    x = _mm_xor_si128(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    x = _mm_xor_si128(x, _mm_srli_si128(x, 8));
+    x = _mm_xor_si128(x, _mm_srli_si128(x, 4));
+    x = _mm_xor_si128(x, _mm_srli_si128(x, 2));
+    x = _mm_xor_si128(x, _mm_srli_si128(x, 1));
+    scan->sum = (uint8_t)_mm_cvtsi128_si32(x);
+
+    return stop;
+}
+
+/** \brief SSE2 scanner, 16 characters per compare
+ *
+ * \param sentence starting at '$', length, nmeascan_t structure with field 0 set
+ * \return size_t offset of the '*' or line end, len if there is none
+ */
+__attribute__((target("sse2")))
+static size_t NmeaScanSse2(const char *s, size_t len, nmeascan_t *scan)
+{
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i star  = _mm_set1_epi8('*');
+    const __m128i cr    = _mm_set1_epi8('\r');
+    const __m128i lf    = _mm_set1_epi8('\n');
+    const __m128i index = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m128i acc = _mm_setzero_si128();
+    __m128i v;
+    char tail[16];
+    unsigned term, commas;
+    size_t i, stop = len;
+    int bit;
+
+    for(i = 1; i < len; i += 16)
+    {
+        if(len - i >= 16)
+        {
+            v = _mm_loadu_si128((const __m128i *)(s + i));
+        }
+        else
+        {
+            memset(tail, 0, sizeof(tail));
+            memcpy(tail, s + i, len - i);
+            v = _mm_loadu_si128((const __m128i *)tail);
+        }
+        term = (unsigned)_mm_movemask_epi8(_mm_or_si128(
+                   _mm_cmpeq_epi8(v, star),
+                   _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf))));
+        commas = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(v, comma));
+        if(term != 0)
+        {
+            bit = __builtin_ctz(term);
+            commas &= (1u << bit) - 1;
+            v = _mm_and_si128(v, _mm_cmplt_epi8(index, _mm_set1_epi8((char)bit)));
+            stop = i + bit;
+        }
+        acc = _mm_xor_si128(acc, v);
+        NmeaScanCommas(scan, commas, i);
+        if(term != 0) { break; }
+    }
+
+    acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 8));
+    acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 4));
+    acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 2));
+    acc = _mm_xor_si128(acc, _mm_srli_si128(acc, 1));
+    scan->sum = (uint8_t)_mm_cvtsi128_si32(acc);
+
+    return stop;
+}
+#endif
+
+static nmea_scan_kernel NmeaScanKernel = NmeaScanScalar;
+static int NmeaScanKernelId = NMEA_SCAN_SCALAR;
+
+/** \brief Choose the sentence scanner, falling back to what the CPU supports
+ *
+ * \param NMEA_SCAN_SCALAR, NMEA_SCAN_SSE2 or NMEA_SCAN_AVX2
+ * \return int scanner in use
+ */
+int nmea_select_scan_kernel(int kernel)
+{
+    NmeaScanKernel = NmeaScanScalar;
+    NmeaScanKernelId = NMEA_SCAN_SCALAR;
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if(kernel >= NMEA_SCAN_AVX2 && __builtin_cpu_supports("avx2"))
+    {
+        NmeaScanKernel = NmeaScanAvx2;
+        NmeaScanKernelId = NMEA_SCAN_AVX2;
+    }
+    else if(kernel >= NMEA_SCAN_SSE2 && __builtin_cpu_supports("sse2"))
+    {
+        NmeaScanKernel = NmeaScanSse2;
+        NmeaScanKernelId = NMEA_SCAN_SSE2;
+    }
+#endif
+
+    return NmeaScanKernelId;
+}
+
+/** \brief Validate the checksum of a sentence and locate its fields in one pass
+ *
+ * \param sentence starting at '$', length (may include the line end), nmeascan_t structure
+ * \return size_t characters from '$' through the checksum, or to the line end if there is none
+ */
+size_t nmea_scan(const char *s, size_t len, nmeascan_t *scan)
+{
+    size_t stop;
+    int hi, lo;
+
+    scan->valid = 0;
+    scan->check = 0;
+    scan->fields = 1;
+    scan->field[0] = 1;
+    scan->length = len;
+    if(len == 0 || s[0] != '$') { return 0; }
+
+    stop = NmeaScanKernel(s, len, scan);
+    scan->field[scan->fields] = (uint16_t)(stop + 1);
+    scan->length = stop;
+
+    if(stop + 2 < len && s[stop] == '*')
+    {
+        hi = NmeaHexDigit(s[stop + 1]);
+        lo = NmeaHexDigit(s[stop + 2]);
+        if(hi >= 0 && lo >= 0)
+        {
+            scan->check = (uint8_t)((hi << 4) | lo);
+            scan->valid = (scan->check == scan->sum);
+            scan->length = stop + 3;
+        }
+    }
+
+    return scan->length;
+}
+
+/** \brief Value of a numeric field
+ *
+ * \param nmeafield_t structure
+ * \return double value, 0 if the field is empty
+ */
+static double NmeaFieldValue(const nmeafield_t *f)
+{
+    double value = (double)f->mantissa;
+
+    if(f->frac > 0) { value /= nmeapow10[f->frac]; }
+
+    return f->negative ? -value : value;
+}
+
+/** \brief Integer part of a numeric field
+ *
+ * \param nmeafield_t structure
+ * \return uint64_t value, 0 if the field is empty
+ */
+static uint64_t NmeaFieldInt(const nmeafield_t *f)
+{
+    return f->mantissa / nmeapow10i[(f->frac < 0) ? 0 : f->frac];
+}
+
+/** \brief Store a GGA field
+ *
+ * \param record, field index, field
+ * \return void
+ */
+static void NmeaGgaField(nmearecord_t *r, int i, const nmeafield_t *f)
+{
+    gpgga_t *loc = &r->gpgga;
+
+    switch(i)
+    {
+        case 1:
+            loc->utc = NmeaFieldValue(f);
+            loc->utcms = NmeaMilliseconds(f->mantissa, f->frac);
+            break;
+        case 2:
+            loc->latitude = NmeaFieldValue(f);
+            loc->latmicro = NmeaMicroDegrees(f->mantissa, f->frac);
+            break;
+        case 3:
+            loc->lat = f->first;
+            if(f->first == 'S') { loc->latmicro = -loc->latmicro; }
+            break;
+        case 4:
+            loc->longitude = NmeaFieldValue(f);
+            loc->lonmicro = NmeaMicroDegrees(f->mantissa, f->frac);
+            break;
+        case 5:
+            loc->lon = f->first;
+            if(f->first == 'W') { loc->lonmicro = -loc->lonmicro; }
+            break;
+        case 6: loc->quality = (uint8_t)NmeaFieldInt(f); break;
+        case 7: loc->satellites = (uint8_t)NmeaFieldInt(f); break;
+        case 9: loc->altitude = NmeaFieldValue(f); break;
+    }
+}
+
+/** \brief Store an RMC field
+ *
+ * \param record, field index, field
+ * \return void
+ */
+static void NmeaRmcField(nmearecord_t *r, int i, const nmeafield_t *f)
+{
+    gprmc_t *loc = &r->gprmc;
+
+    switch(i)
+    {
+        case 1:
+            loc->utc = NmeaFieldValue(f);
+            loc->utcms = NmeaMilliseconds(f->mantissa, f->frac);
+            break;
+        case 3:
+            loc->latitude = NmeaFieldValue(f);
+            loc->latmicro = NmeaMicroDegrees(f->mantissa, f->frac);
+            break;
+        case 4:
+            loc->lat = f->first;
+            if(f->first == 'S') { loc->latmicro = -loc->latmicro; }
+            break;
+        case 5:
+            loc->longitude = NmeaFieldValue(f);
+            loc->lonmicro = NmeaMicroDegrees(f->mantissa, f->frac);
+            break;
+        case 6:
+            loc->lon = f->first;
+            if(f->first == 'W') { loc->lonmicro = -loc->lonmicro; }
+            break;
+        case 7: loc->speed = NmeaFieldValue(f); break;
+        case 8: loc->course = NmeaFieldValue(f); break;
+        case 9:
+            loc->date = NmeaFieldValue(f);
+            loc->datedmy = (uint32_t)NmeaFieldInt(f);
+            break;
+    }
 }
 
+/** \brief Store a GSA field
+ *
+ * \param record, field index, field
+ * \return void
+ */
+static void NmeaGsaField(nmearecord_t *r, int i, const nmeafield_t *f)
+{
+    gpgsa_t *gsa = &r->gpgsa;
+
+    if(i >= 3 && i < 3 + NMEAGSAPRNS)
+    {
+        if(f->first != '\0') { gsa->prn[gsa->used++] = (uint8_t)NmeaFieldInt(f); }
+        return;
+    }
+
+    switch(i)
+    {
+        case 1: gsa->mode = f->first; break;
+        case 2: gsa->fix = (uint8_t)NmeaFieldInt(f); break;
+        case 3 + NMEAGSAPRNS: gsa->pdop = NmeaFieldValue(f); break;
+        case 4 + NMEAGSAPRNS: gsa->hdop = NmeaFieldValue(f); break;
+        case 5 + NMEAGSAPRNS: gsa->vdop = NmeaFieldValue(f); break;
+    }
+}
+
+/** \brief Store a GSV field
+ *
+ * Fields 4 onwards come in groups of four (PRN, elevation, azimuth, SNR), one per satellite.
+ * The signal ID that NMEA 4.10 appends after the last group is ignored.
+ *
+ * \param record, field index, field
+ * \return void
+ */
+static void NmeaGsvField(nmearecord_t *r, int i, const nmeafield_t *f)
+{
+    gpgsv_t *gsv = &r->gpgsv;
+    struct gpgsvsat *sat;
+
+    switch(i)
+    {
+        case 1: gsv->messages = (uint8_t)NmeaFieldInt(f); return;
+        case 2: gsv->message = (uint8_t)NmeaFieldInt(f); return;
+        case 3: gsv->visible = (uint8_t)NmeaFieldInt(f); return;
+    }
+
+    if(i >= 4 + 4 * NMEAGSVSATS) { return; }
+    sat = &gsv->sat[(i - 4) / 4];
+    switch((i - 4) % 4)
+    {
+        case 0:
+            if(f->first == '\0') { return; }
+            sat->prn = (uint8_t)NmeaFieldInt(f);
+            gsv->count = (uint8_t)((i - 4) / 4 + 1);
+            break;
+        case 1: sat->elevation = (uint8_t)NmeaFieldInt(f); break;
+        case 2: sat->azimuth = (uint16_t)NmeaFieldInt(f); break;
+        case 3: sat->snr = (uint8_t)NmeaFieldInt(f); break;
+    }
+}
+
+/** \brief Store a GLL field
+ *
+ * \param record, field index, field
+ * \return void
+ */
+static void NmeaGllField(nmearecord_t *r, int i, const nmeafield_t *f)
+{
+    gpgll_t *loc = &r->gpgll;
+
+    switch(i)
+    {
+        case 1:
+            loc->latitude = NmeaFieldValue(f);
+            loc->latmicro = NmeaMicroDegrees(f->mantissa, f->frac);
+            break;
+        case 2:
+            loc->lat = f->first;
+            if(f->first == 'S') { loc->latmicro = -loc->latmicro; }
+            break;
+        case 3:
+            loc->longitude = NmeaFieldValue(f);
+            loc->lonmicro = NmeaMicroDegrees(f->mantissa, f->frac);
+            break;
+        case 4:
+            loc->lon = f->first;
+            if(f->first == 'W') { loc->lonmicro = -loc->lonmicro; }
+            break;
+        case 5:
+            loc->utc = NmeaFieldValue(f);
+            loc->utcms = NmeaMilliseconds(f->mantissa, f->frac);
+            break;
+        case 6: loc->status = f->first; break;
+    }
+}
+
+/** \brief Store a VTG field
+ *
+ * \param record, field index, field
+ * \return void
+ */
+static void NmeaVtgField(nmearecord_t *r, int i, const nmeafield_t *f)
+{
+    gpvtg_t *vtg = &r->gpvtg;
+
+    switch(i)
+    {
+        case 1: vtg->course = NmeaFieldValue(f); break;
+        case 3: vtg->coursemag = NmeaFieldValue(f); break;
+        case 5: vtg->speed = NmeaFieldValue(f); break;
+        case 7: vtg->speedkmh = NmeaFieldValue(f); break;
+    }
+}
+
+// Sentences with a parser, looked up through nmeadispatch[] by their formatter
+static const nmeasentence_t nmeasentences[] =
+{
+    { "GGA", NMEA_GPGGA, NmeaGgaField },
+    { "RMC", NMEA_GPRMC, NmeaRmcField },
+    { "GSA", NMEA_GPGSA, NmeaGsaField },
+    { "GSV", NMEA_GPGSV, NmeaGsvField },
+    { "GLL", NMEA_GPGLL, NmeaGllField },
+    { "VTG", NMEA_GPVTG, NmeaVtgField },
+};
+
+#define NMEASENTENCES (sizeof(nmeasentences) / sizeof(nmeasentences[0]))
+
+// Open addressed hash of the formatter, slot holds the table index + 1, 0 when free
+static uint8_t nmeadispatch[NMEADISPATCHSZ];
+
+/** \brief Slot of a three character sentence formatter
+ *
+ * \param formatter packed as ('G' << 16) | ('G' << 8) | 'A'
+ * \return unsigned first slot to probe
+ */
+static unsigned NmeaHash(uint32_t id)
+{
+    return (id * 2654435761u) >> 26 & (NMEADISPATCHSZ - 1);
+}
+
+/** \brief Find the parser of a sentence from its address
+ *
+ * The address is the talker and the formatter, eg: GPGGA.  GPS (GP), multi-constellation
+ * (GN), GLONASS (GL), Galileo (GA), BeiDou (GB, BD) and QZSS (GQ) talkers share one parser.
+ *
+ * \param last five address characters packed into the low 40 bits
+ * \return const nmeasentence_t* table entry, NULL if the sentence has no parser
+ */
+static const nmeasentence_t *NmeaLookup(uint64_t address)
+{
+    const nmeasentence_t *e;
+    uint32_t id = (uint32_t)(address & 0xFFFFFF);
+    unsigned slot;
+
+    switch((uint32_t)(address >> 24) & 0xFFFF)
+    {
+        case ('G' << 8) | 'P':
+        case ('G' << 8) | 'N':
+        case ('G' << 8) | 'L':
+        case ('G' << 8) | 'A':
+        case ('G' << 8) | 'B':
+        case ('B' << 8) | 'D':
+        case ('G' << 8) | 'Q':
+            break;
+        default:
+            return NULL;
+    }
+
+    for(slot = NmeaHash(id); nmeadispatch[slot] != 0; slot = (slot + 1) & (NMEADISPATCHSZ - 1))
+    {
+        e = &nmeasentences[nmeadispatch[slot] - 1];
+        if((uint32_t)(((uint8_t)e->id[0] << 16) | ((uint8_t)e->id[1] << 8) | (uint8_t)e->id[2]) == id)
+        {
+            return e;
+        }
+    }
+
+    return NULL;
+}
+
+/** \brief Look up the parser of a scanned sentence
+ *
+ * \param sentence, nmeascan_t structure
+ * \return const nmeasentence_t* table entry, NULL if the address is not five characters or
+ *         the sentence has no parser
+ */
+static const nmeasentence_t *NmeaScanLookup(const char *s, const nmeascan_t *scan)
+{
+    uint64_t address = 0;
+    int i;
+
+    if(scan->fields < 2 || scan->field[1] != 7) { return NULL; }
+    for(i = 1; i <= 5; i++) { address = (address << 8) | (uint8_t)s[i]; }
+
+    return NmeaLookup(address);
+}
+
+__attribute__((constructor))
+static void NmeaInit(void)
+{
+    unsigned i, slot;
+
+    for(i = 0; i < NMEASENTENCES; i++)
+    {
+        slot = NmeaHash(((uint8_t)nmeasentences[i].id[0] << 16) |
+                        ((uint8_t)nmeasentences[i].id[1] << 8) | (uint8_t)nmeasentences[i].id[2]);
+        while(nmeadispatch[slot] != 0) { slot = (slot + 1) & (NMEADISPATCHSZ - 1); }
+        nmeadispatch[slot] = (uint8_t)(i + 1);
+    }
+
+    nmea_select_scan_kernel(NMEA_SCAN_AVX2);
+}
+
+/** \brief Get the record type of a scanned sentence from its address
+ *
+ * \param sentence, nmeascan_t structure
+ * \return uint8_t NMEA_GPGGA, NMEA_GPRMC, ... or NMEA_UNKNOWN
+ */
+uint8_t nmea_scan_type(const char *s, const nmeascan_t *scan)
+{
+    const nmeasentence_t *e = NmeaScanLookup(s, scan);
+
+    return (e != NULL) ? e->type : NMEA_UNKNOWN;
+}
+
+/** \brief Fill a record from the field offsets of a scanned sentence
+ *
+ * \param sentence, nmeascan_t structure, record
+ * \return uint8_t message type, NMEA_UNKNOWN if the checksum is wrong or there is no parser
+ */
+uint8_t nmea_scan_parse(const char *s, const nmeascan_t *scan, nmearecord_t *record)
+{
+    const nmeasentence_t *e;
+    nmeafield_t f;
+    const char *p;
+    size_t len;
+    int i;
+
+    if(!scan->valid || (e = NmeaScanLookup(s, scan)) == NULL) { return NMEA_UNKNOWN; }
+    memset(record, 0, sizeof(nmearecord_t));
+
+    for(i = 1; i < scan->fields; i++)
+    {
+        p = s + scan->field[i];
+        len = scan->field[i + 1] - scan->field[i] - 1;
+        f.first = (len > 0) ? *p : '\0';
+        f.negative = (len > 0 && *p == '-');
+        NmeaDecimal(p + f.negative, len - f.negative, &f.mantissa, &f.frac);
+        e->field(record, i, &f);
+    }
+
+    return e->type;
+}
+
+/** \brief Clear the accumulators for the next field
+ *
+ * \param nmeastream_t structure
+ * \return void
+ */
+static void NmeaFieldReset(nmeastream_t *s)
+{
+    s->value.mantissa = 0;
+    s->value.frac = -1;
+    s->value.negative = 0;
+    s->value.first = '\0';
+}
+
+/** \brief Store the field that just ended in the record being filled
+ *
+ * The address field selects the parser from the dispatch table, so any talker (GP, GN, GL,
+ * GA, GB, BD, GQ) is accepted.  Other sentences are skipped without being validated.
+ *
+ * \param nmeastream_t structure
+ * \return void
+ */
+static void NmeaFieldEnd(nmeastream_t *s)
+{
+    if(s->field == 0)
+    {
+        s->sentence = (s->length == 5) ? NmeaLookup(s->address) : NULL;
+        if(s->sentence == NULL)
+        {
+            s->type = NMEA_UNKNOWN;
+            s->state = NMEA_STATE_SYNC;
+            return;
+        }
+        s->type = s->sentence->type;
+        memset(&s->record, 0, sizeof(nmearecord_t));
+        return;
+    }
+
+    s->sentence->field(&s->record, s->field, &s->value);
+}
+
+/** \brief Prepare a streaming parser
+ *
+ * \param nmeastream_t structure, callback for valid sentences, context passed to the callback
+ * \return void
+ */
+void nmea_stream_init(nmeastream_t *s, nmea_callback callback, void *ctx)
+{
+    memset(s, 0, sizeof(nmeastream_t));
+    s->state = NMEA_STATE_SYNC;
+    s->callback = callback;
+    s->ctx = ctx;
+}
+
+/** \brief Parse raw bytes in place
+ *
+ * Bytes may be split anywhere, a sentence that spans two calls is continued.  Each byte is
+ * looked at once: the checksum, the fields and the record are all updated in the same pass.
+ *
+ * \param nmeastream_t structure, data, number of bytes
+ * \return size_t number of records passed to the callback
+ */
+size_t nmea_stream_feed(nmeastream_t *s, const char *data, size_t len)
+{
+    const char *end = data + len;
+    size_t records = 0;
+    char c;
+    int d;
+
+    while(data < end)
+    {
+        c = *data++;
+
+        switch(s->state)
+        {
+            case NMEA_STATE_SYNC:
+                if(c == '$')
+                {
+                    s->state = NMEA_STATE_BODY;
+                    s->length = 0;
+                    s->field = 0;
+                    s->sum = 0;
+                    s->address = 0;
+                    s->type = NMEA_UNKNOWN;
+                    NmeaFieldReset(s);
+                }
+                break;
+
+            case NMEA_STATE_BODY:
+                if(c >= '0' && c <= '9')
+                {
+                    if(s->value.frac < NMEAMAXFRAC)
+                    {
+                        s->value.mantissa = s->value.mantissa * 10 + (uint64_t)(c - '0');
+                        if(s->value.frac >= 0) { s->value.frac++; }
+                    }
+                    if(s->value.first == '\0') { s->value.first = c; }
+                }
+                else if(c == ',')
+                {
+                    NmeaFieldEnd(s);
+                    s->field++;
+                    NmeaFieldReset(s);
+                }
+                else if(c == '*')
+                {
+                    NmeaFieldEnd(s);
+                    s->state = NMEA_STATE_CK1;
+                    break;
+                }
+                else if(c == '$' || c == '\r' || c == '\n')
+                {
+                    // Sentence cut short, resynchronise on this character
+                    s->framingerrors++;
+                    s->state = NMEA_STATE_SYNC;
+                    data--;
+                    break;
+                }
+                else
+                {
+                    if(s->field == 0)   { s->address = ((s->address << 8) | (uint8_t)c) & 0xFFFFFFFFFFULL; }
+                    else if(c == '.')   { if(s->value.frac < 0) { s->value.frac = 0; } }
+                    else if(c == '-')   { s->value.negative = 1; }
+                    if(s->value.first == '\0') { s->value.first = c; }
+                }
+                s->sum ^= (uint8_t)c;
+                if(++s->length > NMEAMSGSZ)
+                {
+                    s->framingerrors++;
+                    s->state = NMEA_STATE_SYNC;
+                }
+                break;
+
+            case NMEA_STATE_CK1:
+                d = NmeaHexDigit(c);
+                if(d < 0)
+                {
+                    s->framingerrors++;
+                    s->state = NMEA_STATE_SYNC;
+                    data--;
+                    break;
+                }
+                s->check = (uint8_t)(d << 4);
+                s->state = NMEA_STATE_CK2;
+                break;
+
+            case NMEA_STATE_CK2:
+                d = NmeaHexDigit(c);
+                s->state = NMEA_STATE_SYNC;
+                if(d < 0)
+                {
+                    s->framingerrors++;
+                    data--;
+                    break;
+                }
+                if((s->check | d) != s->sum)
+                {
+                    s->checksumerrors++;
+                    break;
+                }
+                s->sentences++;
+                records++;
+                if(s->callback != NULL) { s->callback(s->type, &s->record, s->ctx); }
+                break;
+        }
+    }
+
+    return records;
+}
+
+/** \brief Parse everything waiting in a ring buffer without copying it out
+ *
+ * \param nmeastream_t structure, nmearing_t structure
+ * \return size_t number of records passed to the callback
+ */
+size_t nmea_stream_consume(nmeastream_t *s, nmearing_t *ring)
+{
+    size_t records = 0;
+    size_t used, offset, span;
+
+    while((used = ring->head - ring->tail) > 0)
+    {
+        offset = ring->tail & (NMEARINGSZ - 1);
+        span = NMEARINGSZ - offset;
+        if(span > used) { span = used; }
+        records += nmea_stream_feed(s, ring->buf + offset, span);
+        ring->tail += span;
+    }
+
+    return records;
+}
+
+/** \brief Get the contiguous free space of a ring buffer, to read() straight into it
+ *
+ * \param nmearing_t structure, returned number of free bytes at the pointer
+ * \return char* where the next bytes go
+ */
+char *nmea_ring_write_ptr(nmearing_t *ring, size_t *len)
+{
+    size_t offset = ring->head & (NMEARINGSZ - 1);
+    size_t space = NMEARINGSZ - (ring->head - ring->tail);
+
+    *len = NMEARINGSZ - offset;
+    if(*len > space) { *len = space; }
+
+    return ring->buf + offset;
+}
+
+/** \brief Mark bytes written at nmea_ring_write_ptr() as available to the parser
+ *
+ * \param nmearing_t structure, number of bytes written
+ * \return void
+ */
+void nmea_ring_commit(nmearing_t *ring, size_t len)
+{
+    ring->head += len;
+}
+
+/** \brief Copy bytes into a ring buffer
+ *
+ * \param nmearing_t structure, data, number of bytes
+ * \return size_t number of bytes stored, less than len when the ring is full
+ */
+size_t nmea_ring_write(nmearing_t *ring, const char *data, size_t len)
+{
+    size_t done = 0, span;
+    char *p;
+
+    while(done < len)
+    {
+        p = nmea_ring_write_ptr(ring, &span);
+        if(span == 0) { break; }
+        if(span > len - done) { span = len - done; }
+        memcpy(p, data + done, span);
+        nmea_ring_commit(ring, span);
+        done += span;
+    }
+
+    return done;
+}
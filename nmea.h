@@ -16,6 +16,10 @@
 #define NMEA_GPRMC_STR "$GPRMC"
 #define NMEA_GPGGA 0x02
 #define NMEA_GPGGA_STR "$GPGGA"
+#define NMEA_GPGSA 0x04
+#define NMEA_GPGSV 0x08
+#define NMEA_GPGLL 0x10
+#define NMEA_GPVTG 0x20
 #define NMEA_UNKNOWN 0x00
 #define _COMPLETED 0x03
 
@@ -24,6 +28,21 @@
 
 #define NMEAMSGSZ 82
 
+// Fixed-point decoding
+#define NMEAMICRO 1000000   // coordinate scale, micro-degrees per degree
+#define NMEACOORDFRAC 9     // minute decimals kept when converting a coordinate
+
+// Sentence scanner
+#define NMEAMAXFIELDS 32    // fields located per sentence, the address is field 0
+#define NMEA_SCAN_SCALAR 0  // portable byte loop
+#define NMEA_SCAN_SSE2 1    // x86 SSE2, 16 characters per instruction
+#define NMEA_SCAN_AVX2 2    // x86 AVX2, 32 characters per instruction
+
+// Sentence dispatch
+#define NMEADISPATCHSZ 64   // slots of the sentence ID hash table, a power of two
+#define NMEAGSAPRNS 12      // satellites listed by a GSA sentence
+#define NMEAGSVSATS 4       // satellites described by one GSV sentence
+
 struct gpgga
 {
 	// UTC Time
@@ -42,6 +61,11 @@ struct gpgga
     uint8_t satellites;
     // Altitude eg: 280.2 (Meters above mean sea level)
     double altitude;
+    // UTC time of day in milliseconds
+    uint32_t utcms;
+    // Latitude and longitude in signed micro-degrees, north and east positive
+    int32_t latmicro;
+    int32_t lonmicro;
 };
 
 typedef struct gpgga gpgga_t;
@@ -56,19 +80,192 @@ struct gprmc
     double speed;
     double course;
 	double date;
+    uint32_t utcms;         // UTC time of day in milliseconds
+    int32_t latmicro;       // signed micro-degrees, north positive
+    int32_t lonmicro;       // signed micro-degrees, east positive
+    uint32_t datedmy;       // date as the integer ddmmyy
 };
 typedef struct gprmc gprmc_t;
 
+// Result of nmea_scan(), field i is s[field[i]] up to the character before s[field[i+1]-1]
+struct nmeascan
+{
+    uint8_t sum;            // XOR of the characters between '$' and '*'
+    uint8_t check;          // received checksum
+    uint8_t valid;          // 1 when '*' and two hex digits follow and they match sum
+    int fields;             // fields located, at most NMEAMAXFIELDS
+    uint16_t field[NMEAMAXFIELDS+1];    // start of each field, then '*' + 1
+    size_t length;          // characters from '$' to the end of the checksum or the line
+};
+typedef struct nmeascan nmeascan_t;
+
+// GSA: DOP and active satellites
+struct gpgsa
+{
+    char mode;              // M manual, A automatic 2D/3D
+    uint8_t fix;            // 1 no fix, 2 2D, 3 3D
+    uint8_t used;           // satellites listed in prn[]
+    uint8_t prn[NMEAGSAPRNS];
+    double pdop;
+    double hdop;
+    double vdop;
+};
+typedef struct gpgsa gpgsa_t;
+
+// GSV: satellites in view, up to NMEAGSVSATS per sentence
+struct gpgsvsat
+{
+    uint8_t prn;
+    uint8_t elevation;      // degrees
+    uint16_t azimuth;       // degrees true
+    uint8_t snr;            // dB-Hz, 0 when not tracked
+};
+
+struct gpgsv
+{
+    uint8_t messages;       // sentences in this cycle
+    uint8_t message;        // number of this sentence, from 1
+    uint8_t visible;        // satellites in view
+    uint8_t count;          // entries filled in sat[]
+    struct gpgsvsat sat[NMEAGSVSATS];
+};
+typedef struct gpgsv gpgsv_t;
+
+// GLL: geographic position
+struct gpgll
+{
+    double latitude;
+    char lat;
+    double longitude;
+    char lon;
+    double utc;
+    char status;            // A valid, V invalid
+    uint32_t utcms;
+    int32_t latmicro;
+    int32_t lonmicro;
+};
+typedef struct gpgll gpgll_t;
+
+// VTG: course and speed over ground
+struct gpvtg
+{
+    double course;          // degrees true
+    double coursemag;       // degrees magnetic
+    double speed;           // knots
+    double speedkmh;        // kilometres per hour
+};
+typedef struct gpvtg gpvtg_t;
+
+// Any record produced by the parsers, the member is selected by the message type
+union nmearecord
+{
+    gpgga_t gpgga;
+    gprmc_t gprmc;
+    gpgsa_t gpgsa;
+    gpgsv_t gpgsv;
+    gpgll_t gpgll;
+    gpvtg_t gpvtg;
+};
+typedef union nmearecord nmearecord_t;
+
+// One field as accumulated by the parsers, handed to the per-sentence field handlers
+struct nmeafield
+{
+    uint64_t mantissa;      // digits without the decimal point
+    int frac;               // digits after the decimal point, -1 before it
+    int negative;
+    char first;             // first character of the field, '\0' when empty
+};
+typedef struct nmeafield nmeafield_t;
+
+// Dispatch table entry, field() stores field index (from 1) of a sentence in the record
+typedef void (*nmea_field_handler)(nmearecord_t *, int, const nmeafield_t *);
+
+struct nmeasentence
+{
+    char id[4];             // sentence formatter, eg: GGA
+    uint8_t type;           // NMEA_GPGGA, NMEA_GPRMC, ...
+    nmea_field_handler field;
+};
+typedef struct nmeasentence nmeasentence_t;
+
 struct nmeamsg
 {
     char msgstr[NMEAMSGSZ+1];
 };
 typedef struct nmeamsg nmeamsg_s;
 
+// Streaming parser constants
+#define NMEARINGSZ 4096     // ring buffer size, must be a power of two
+#define NMEAMAXFRAC 15      // decimal places kept per numeric field
+
+// Parser states
+#define NMEA_STATE_SYNC 0   // waiting for '$'
+#define NMEA_STATE_BODY 1   // inside the sentence, checksum accumulating
+#define NMEA_STATE_CK1 2    // first checksum digit
+#define NMEA_STATE_CK2 3    // second checksum digit
+
+// Byte ring shared by the reader (head) and the parser (tail), both free running
+struct nmearing
+{
+    char buf[NMEARINGSZ];
+    size_t head;
+    size_t tail;
+};
+typedef struct nmearing nmearing_t;
+
+// Called for every sentence with a valid checksum, record points to the nmearecord_t member
+// selected by type
+typedef void (*nmea_callback)(uint8_t type, const void *record, void *ctx);
+
+struct nmeastream
+{
+    // Sentence state
+    int state;
+    int length;             // characters since '$'
+    int field;              // current field index, 0 is the address
+    uint8_t type;           // NMEA_GPGGA, NMEA_GPRMC, ... or NMEA_UNKNOWN
+    uint8_t sum;            // running checksum
+    uint8_t check;          // received checksum
+    uint64_t address;       // last five address characters (talker and sentence formatter)
+    const nmeasentence_t *sentence; // dispatch table entry of the sentence being parsed
+
+    // Current field
+    nmeafield_t value;
+
+    // Record being filled, passed to the callback once the checksum matches
+    nmearecord_t record;
+
+    nmea_callback callback;
+    void *ctx;
+
+    // Counters
+    unsigned long sentences;
+    unsigned long checksumerrors;
+    unsigned long framingerrors;
+};
+typedef struct nmeastream nmeastream_t;
+
 uint8_t nmea_get_message_type(const char *);
 uint8_t nmea_valid_checksum(const char *);
 void nmea_parse_gpgga(char *, gpgga_t *);
 void nmea_parse_gprmc(char *, gprmc_t *);
 
+int nmea_decode_coord(const char *, size_t, int32_t *);
+int nmea_decode_time(const char *, size_t, uint32_t *);
+int nmea_decode_date(const char *, size_t, uint32_t *);
+
+int nmea_select_scan_kernel(int);
+size_t nmea_scan(const char *, size_t, nmeascan_t *);
+uint8_t nmea_scan_type(const char *, const nmeascan_t *);
+uint8_t nmea_scan_parse(const char *, const nmeascan_t *, nmearecord_t *);
+
+void nmea_stream_init(nmeastream_t *, nmea_callback, void *);
+size_t nmea_stream_feed(nmeastream_t *, const char *, size_t);
+size_t nmea_stream_consume(nmeastream_t *, nmearing_t *);
+size_t nmea_ring_write(nmearing_t *, const char *, size_t);
+char *nmea_ring_write_ptr(nmearing_t *, size_t *);
+void nmea_ring_commit(nmearing_t *, size_t);
+
 #endif
 
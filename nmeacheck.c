@@ -0,0 +1,324 @@
+/** \file nmeacheck.c
+ *  \brief Regression check of the fixed-point NMEA decoders and the streaming parser
+ *
+ *  Every coordinate of the form dddmm.mmmm (3 and 4 decimals), every hhmmss.sss time and
+ *  every ddmmyy date is decoded with nmea_decode_coord(), nmea_decode_time() and
+ *  nmea_decode_date() and compared with the atof() and gps_deg_dec() results they replaced.
+ *  Each GGA and RMC sentence of the given logs is then parsed by nmea_stream_feed() and by
+ *  nmea_parse_gpgga()/nmea_parse_gprmc(), and every field of the two records is compared.
+ *  Any mismatch fails the run.
+ *
+ *  Usage: nmeacheck log...
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include "nmea.h"
+#include "gps.h"
+
+#define CHECKMAXSHOWN 5             // mismatches printed per check
+#define CHECKLINESZ   256
+
+typedef struct checkstats
+{
+    unsigned long checked;
+    unsigned long mismatches;
+} checkstats_s;
+
+// Record of the last sentence passed to the streaming parser callback
+typedef struct checkrecord
+{
+    uint8_t type;
+    nmearecord_t record;
+} checkrecord_s;
+
+/** \brief Print one check line
+ *
+ * \param name, statistics
+ * \return int 1 when nothing differed, 0 otherwise
+ */
+static int CheckReport(const char *name, const checkstats_s *st)
+{
+    int pass = (st->mismatches == 0) && (st->checked > 0);
+
+    printf("  %-36s %12lu %12lu   %s\n", name, st->checked, st->mismatches, pass ? "ok" : "FAIL");
+
+    return pass;
+}
+
+/** \brief Count a mismatch and print the first few
+ *
+ * \param statistics, field, decoded value, reference value
+ * \return void
+ */
+static void CheckMismatch(checkstats_s *st, const char *field, long long got, long long want)
+{
+    if(st->mismatches++ < CHECKMAXSHOWN)
+    {
+        printf("    %s: decoded %lld, reference %lld\n", field, got, want);
+    }
+}
+
+/** \brief Increment the decimal digits of a string in place, wrapping to zeros
+ *
+ * \param digits, number of digits
+ * \return int 1 while the digits have not wrapped, 0 once they have
+ */
+static int CheckIncrement(char *s, int n)
+{
+    while(n-- > 0)
+    {
+        if(s[n] != '9') { s[n]++; return 1; }
+        s[n] = '0';
+    }
+
+    return 0;
+}
+
+/** \brief Compare nmea_decode_coord() with atof() + gps_deg_dec() over every dddmm.mmmm
+ *
+ * \param statistics, number of decimals
+ * \return void
+ */
+static void CheckCoords(checkstats_s *st, int decimals)
+{
+    char s[16];
+    int32_t micro, want;
+    int deg, min;
+
+    for(deg = 0; deg < 180; deg++)
+    {
+        for(min = 0; min < 60; min++)
+        {
+            sprintf(s, "%03d%02d.%0*d", deg, min, decimals, 0);
+            do
+            {
+                nmea_decode_coord(s, strlen(s), &micro);
+                want = (int32_t)llround(gps_deg_dec(atof(s)) * NMEAMICRO);
+                if(micro != want) { CheckMismatch(st, s, micro, want); }
+                st->checked++;
+            } while(CheckIncrement(s + 6, decimals));
+        }
+    }
+}
+
+/** \brief Compare nmea_decode_time() with atof() over every hhmmss.sss
+ *
+ * \param statistics
+ * \return void
+ */
+static void CheckTimes(checkstats_s *st)
+{
+    char s[16];
+    uint32_t ms, want;
+    long whole;
+    double value;
+    int hour, min, sec;
+
+    for(hour = 0; hour < 24; hour++)
+    {
+        for(min = 0; min < 60; min++)
+        {
+            for(sec = 0; sec < 60; sec++)
+            {
+                sprintf(s, "%02d%02d%02d.000", hour, min, sec);
+                do
+                {
+                    nmea_decode_time(s, strlen(s), &ms);
+                    value = atof(s);
+                    whole = (long)value;
+                    want = (uint32_t)((whole / 10000) * 3600000 + (whole / 100 % 100) * 60000 +
+                                      (whole % 100) * 1000 + lround((value - whole) * 1000.0));
+                    if(ms != want) { CheckMismatch(st, s, ms, want); }
+                    st->checked++;
+                } while(CheckIncrement(s + 7, 3));
+            }
+        }
+    }
+}
+
+/** \brief Compare nmea_decode_date() with atof() over every ddmmyy
+ *
+ * \param statistics
+ * \return void
+ */
+static void CheckDates(checkstats_s *st)
+{
+    char s[16];
+    uint32_t dmy, want;
+    int day, month, year;
+
+    for(day = 1; day <= 31; day++)
+    {
+        for(month = 1; month <= 12; month++)
+        {
+            for(year = 0; year < 100; year++)
+            {
+                sprintf(s, "%02d%02d%02d", day, month, year);
+                nmea_decode_date(s, strlen(s), &dmy);
+                want = (uint32_t)atof(s);
+                if(dmy != want) { CheckMismatch(st, s, dmy, want); }
+                st->checked++;
+            }
+        }
+    }
+}
+
+/** \brief Streaming parser callback, keeps the record of the last sentence
+ *
+ * \param message type, record, checkrecord_s structure
+ * \return void
+ */
+static void CheckCollect(uint8_t type, const void *record, void *ctx)
+{
+    checkrecord_s *last = (checkrecord_s *)ctx;
+
+    last->type = type;
+    if(type == NMEA_GPGGA) { last->record.gpgga = *(const gpgga_t *)record; }
+    if(type == NMEA_GPRMC) { last->record.gprmc = *(const gprmc_t *)record; }
+}
+
+/** \brief Compare one field of the stream and string parser records
+ *
+ * \param statistics, sentence, field name, stream value, string parser value
+ * \return void
+ */
+static void CheckField(checkstats_s *st, const char *line, const char *field, double got,
+                       double want)
+{
+    if(got == want) { return; }
+    if(st->mismatches++ < CHECKMAXSHOWN)
+    {
+        printf("    %s\n    %s: stream %.10g, string parser %.10g\n", line, field, got, want);
+    }
+}
+
+/** \brief Compare nmea_stream_feed() with nmea_parse_gpgga()/nmea_parse_gprmc() on a log
+ *
+ * \param statistics, log file name
+ * \return int 1 if the log could be read, 0 otherwise
+ */
+static int CheckLog(checkstats_s *st, const char *fname)
+{
+    char line[CHECKLINESZ], copy[CHECKLINESZ];
+    nmeastream_t stream;
+    checkrecord_s last;
+    gpgga_t gga;
+    gprmc_t rmc;
+    uint8_t type;
+    FILE *fp;
+
+    fp = fopen(fname, "r");
+    if(fp == NULL) { return 0; }
+
+    nmea_stream_init(&stream, CheckCollect, &last);
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        type = nmea_get_message_type(line);
+        if(type != NMEA_GPGGA && type != NMEA_GPRMC) { continue; }
+
+        memset(&last, 0, sizeof(last));
+        nmea_stream_feed(&stream, line, strlen(line));
+        nmea_stream_feed(&stream, "\r\n", 2);
+        st->checked++;
+        if(last.type != type)
+        {
+            printf("    %s\n    not passed to the callback\n", line);
+            st->mismatches++;
+            continue;
+        }
+
+        strcpy(copy, line);
+        if(type == NMEA_GPGGA)
+        {
+            memset(&gga, 0, sizeof(gga));
+            nmea_parse_gpgga(copy, &gga);
+            CheckField(st, line, "utc", last.record.gpgga.utc, gga.utc);
+            CheckField(st, line, "utcms", last.record.gpgga.utcms, gga.utcms);
+            CheckField(st, line, "latitude", last.record.gpgga.latitude, gga.latitude);
+            CheckField(st, line, "latmicro", last.record.gpgga.latmicro, gga.latmicro);
+            CheckField(st, line, "lat", last.record.gpgga.lat, gga.lat);
+            CheckField(st, line, "longitude", last.record.gpgga.longitude, gga.longitude);
+            CheckField(st, line, "lonmicro", last.record.gpgga.lonmicro, gga.lonmicro);
+            CheckField(st, line, "lon", last.record.gpgga.lon, gga.lon);
+            CheckField(st, line, "quality", last.record.gpgga.quality, gga.quality);
+            CheckField(st, line, "satellites", last.record.gpgga.satellites, gga.satellites);
+            CheckField(st, line, "altitude", last.record.gpgga.altitude, gga.altitude);
+        }
+        else
+        {
+            // nmea_parse_gprmc() leaves utc unset
+            memset(&rmc, 0, sizeof(rmc));
+            nmea_parse_gprmc(copy, &rmc);
+            CheckField(st, line, "utcms", last.record.gprmc.utcms, rmc.utcms);
+            CheckField(st, line, "latitude", last.record.gprmc.latitude, rmc.latitude);
+            CheckField(st, line, "latmicro", last.record.gprmc.latmicro, rmc.latmicro);
+            CheckField(st, line, "lat", last.record.gprmc.lat, rmc.lat);
+            CheckField(st, line, "longitude", last.record.gprmc.longitude, rmc.longitude);
+            CheckField(st, line, "lonmicro", last.record.gprmc.lonmicro, rmc.lonmicro);
+            CheckField(st, line, "lon", last.record.gprmc.lon, rmc.lon);
+            CheckField(st, line, "speed", last.record.gprmc.speed, rmc.speed);
+            CheckField(st, line, "course", last.record.gprmc.course, rmc.course);
+            CheckField(st, line, "date", last.record.gprmc.date, rmc.date);
+            CheckField(st, line, "datedmy", last.record.gprmc.datedmy, rmc.datedmy);
+        }
+    }
+    fclose(fp);
+
+    return 1;
+}
+
+/** \brief Run every decoder check, then the parser check on each log
+ *
+ * \param int/char* argument count and log file names
+ * \return int 0 when nothing differed, 1 otherwise
+ */
+int main(int argc, char *argv[])
+{
+    checkstats_s st;
+    char name[64];
+    clock_t t0 = clock();
+    int pass = 1, i;
+
+    if(argc < 2)
+    {
+        fprintf(stderr, "Usage: nmeacheck log...\n");
+        return 1;
+    }
+
+    printf("  %-36s %12s %12s\n", "check", "checked", "mismatches");
+
+    memset(&st, 0, sizeof(st));
+    CheckCoords(&st, 4);
+    pass &= CheckReport("nmea_decode_coord dddmm.mmmm", &st);
+
+    memset(&st, 0, sizeof(st));
+    CheckCoords(&st, 3);
+    pass &= CheckReport("nmea_decode_coord dddmm.mmm", &st);
+
+    memset(&st, 0, sizeof(st));
+    CheckTimes(&st);
+    pass &= CheckReport("nmea_decode_time hhmmss.sss", &st);
+
+    memset(&st, 0, sizeof(st));
+    CheckDates(&st);
+    pass &= CheckReport("nmea_decode_date ddmmyy", &st);
+
+    for(i = 1; i < argc; i++)
+    {
+        memset(&st, 0, sizeof(st));
+        if(!CheckLog(&st, argv[i])) { fprintf(stderr, "Cannot read %s\n", argv[i]); }
+        snprintf(name, sizeof(name), "nmea_stream_feed %s", argv[i]);
+        pass &= CheckReport(name, &st);
+    }
+
+    printf("\n%s (%.1f s)\n", pass ? "decoders ok" : "DECODER MISMATCH",
+           (double)(clock() - t0) / CLOCKS_PER_SEC);
+
+    return pass ? 0 : 1;
+}
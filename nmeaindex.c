@@ -0,0 +1,521 @@
+/** \file nmeaindex.c
+ *  \brief Parallel indexer and time-range query tool for NMEA archives
+ *
+ *  The log is memory-mapped and split into one chunk per thread at sentence boundaries.
+ *  Each thread checks and splits every sentence of its chunk with nmea_scan() and records
+ *  every GGA fix with its byte offset; GGA has no date, so entries take the date of the last RMC, carried
+ *  across chunks once all threads are done.  The entries are sorted by time and written to a
+ *  sidecar index (<log>.idx), which later queries binary search instead of re-parsing the log.
+ *
+ *  Usage: nmeaindex build log [threads]
+ *         nmeaindex info log
+ *         nmeaindex range log from to            (times as YYYY-MM-DDTHH:MM:SS UTC)
+ *         nmeaindex median log YYYY-MM-DD [-a]   (-a includes fixes with quality 0)
+*/
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "nmea.h"
+
+#define IDXMAGIC      "NMEAIDX"
+#define IDXVERSION    1
+#define IDXSUFFIX     ".idx"
+#define IDXMAXTHREADS 64
+#define IDXGROW       65536     // entries added at a time
+#define IDXNODATE     INT32_MIN // day not known yet
+
+typedef struct idxheader
+{
+    char magic[8];              ///< IDXMAGIC, NUL terminated
+    int32_t version;            ///< IDXVERSION
+    int32_t reserved;
+    int64_t count;              ///< entries following the header
+    int64_t logsize;            ///< size of the indexed log, to detect a stale index
+    int64_t logmtime;           ///< modification time of the indexed log
+} idxheader_s;
+
+typedef struct idxentry
+{
+    int64_t time;               ///< UTC milliseconds since 1970
+    int64_t offset;             ///< byte offset of the GGA sentence
+    int32_t latitude;           ///< micro-degrees, north positive
+    int32_t longitude;          ///< micro-degrees, east positive
+    float altitude;             ///< metres above mean sea level
+    uint8_t quality;
+    uint8_t satellites;
+    uint16_t reserved;
+} idxentry_s;
+
+typedef struct idxchunk
+{
+    pthread_t thread;
+    const char *map;
+    size_t start, end;          ///< byte range of the chunk
+    idxentry_s *entry;
+    size_t count, cap;
+    int32_t firstday;           ///< day of the first RMC in the chunk, IDXNODATE if none
+    int32_t day;                ///< current day while parsing, IDXNODATE before the first RMC
+    int64_t lasttod;            ///< time of day of the previous fix, -1 before the first
+    int64_t offset;             ///< offset of the sentence being parsed
+    int failed;
+} idxchunk_s;
+
+/** \brief Days since 1970-01-01 of a civil date
+ *
+ * \param year, month, day
+ * \return int32_t day number
+ */
+static int32_t IdxDays(int y, int m, int d)
+{
+    int era, yoe, doy, doe;
+
+    y -= (m <= 2);
+    era = (y >= 0 ? y : y - 399) / 400;
+    yoe = y - era * 400;
+    doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * 146097 + doe - 719468;
+}
+
+/** \brief Record a GGA fix or track the date of an RMC
+ *
+ * \param message type, record, idxchunk_s structure
+ * \return void
+ */
+static void IdxCollect(uint8_t type, const void *record, void *ctx)
+{
+    idxchunk_s *c = (idxchunk_s *)ctx;
+    const gpgga_t *gga;
+    const gprmc_t *rmc;
+    idxentry_s *e;
+    uint32_t date;
+
+    if(type == NMEA_GPRMC)
+    {
+        rmc = (const gprmc_t *)record;
+        date = rmc->datedmy;
+        if(date == 0) { return; }
+        c->day = IdxDays(2000 + (int)(date % 100), (int)(date / 100 % 100), (int)(date / 10000));
+        if(c->firstday == IDXNODATE) { c->firstday = c->day; }
+        return;
+    }
+
+    if(c->count == c->cap)
+    {
+        c->cap += IDXGROW;
+        e = (idxentry_s *)realloc(c->entry, c->cap * sizeof(idxentry_s));
+        if(e == NULL) { c->failed = 1; return; }
+        c->entry = e;
+    }
+
+    gga = (const gpgga_t *)record;
+    e = &c->entry[c->count++];
+    memset(e, 0, sizeof(*e));
+    e->time = gga->utcms;
+    // A GGA past midnight can come before the RMC carrying the new date
+    if(c->day != IDXNODATE && c->lasttod >= 0 && e->time < c->lasttod - 43200000) { c->day++; }
+    c->lasttod = e->time;
+    e->offset = c->offset;
+    e->latitude = gga->latmicro;
+    e->longitude = gga->lonmicro;
+    e->altitude = (float)gga->altitude;
+    e->quality = gga->quality;
+    e->satellites = gga->satellites;
+    // Entries before the first RMC of the chunk keep the time of day and are flagged for
+    // IdxBuild() to add the date carried from the previous chunk
+    e->reserved = (c->day == IDXNODATE) ? 0 : 1;
+    if(c->day != IDXNODATE) { e->time += (int64_t)c->day * 86400000; }
+}
+
+/** \brief Worker thread, parses one chunk sentence by sentence
+ *
+ * \param idxchunk_s structure
+ * \return NULL
+ */
+static void *IdxWorker(void *arg)
+{
+    idxchunk_s *c = (idxchunk_s *)arg;
+    const char *p = c->map + c->start;
+    const char *end = c->map + c->end;
+    const char *nl;
+    nmeascan_t scan;
+    nmearecord_t record;
+    uint8_t type;
+
+    c->firstday = IDXNODATE;
+    c->day = IDXNODATE;
+    c->lasttod = -1;
+
+    while(p < end && !c->failed)
+    {
+        if(*p == '$')
+        {
+            c->offset = p - c->map;
+            nmea_scan(p, end - p, &scan);
+            type = nmea_scan_type(p, &scan);
+            if((type == NMEA_GPGGA || type == NMEA_GPRMC) && nmea_scan_parse(p, &scan, &record))
+            {
+                IdxCollect(type, &record, c);
+            }
+            p += scan.length;
+        }
+        nl = (const char *)memchr(p, '\n', end - p);
+        if(nl == NULL) { break; }
+        p = nl + 1;
+    }
+
+    return NULL;
+}
+
+/** \brief Sort entries by time, then by position in the log
+ *
+ * \param two idxentry_s
+ * \return int order
+ */
+static int IdxCompare(const void *a, const void *b)
+{
+    const idxentry_s *ea = (const idxentry_s *)a, *eb = (const idxentry_s *)b;
+
+    if(ea->time != eb->time) { return (ea->time > eb->time) - (ea->time < eb->time); }
+    return (ea->offset > eb->offset) - (ea->offset < eb->offset);
+}
+
+/** \brief Memory-map a log read only
+ *
+ * \param file name, returned length, returned stat
+ * \return const char* mapping, NULL on failure
+ */
+static const char *IdxMap(const char *fname, size_t *len, struct stat *st)
+{
+    void *map;
+    int fd;
+
+    fd = open(fname, O_RDONLY);
+    if(fd < 0) { return NULL; }
+    if(fstat(fd, st) != 0 || st->st_size == 0)
+    {
+        close(fd);
+        return NULL;
+    }
+    map = mmap(NULL, st->st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) { return NULL; }
+
+    *len = st->st_size;
+    return (const char *)map;
+}
+
+/** \brief Index a log with several threads and write the sidecar index
+ *
+ * \param log file name, number of threads
+ * \return int 1 on success, 0 on failure
+ */
+static int IdxBuild(const char *fname, int nthreads)
+{
+    static idxchunk_s chunk[IDXMAXTHREADS];
+    char idxname[4096];
+    idxheader_s hdr;
+    idxentry_s *all;
+    struct stat st;
+    struct timespec t0, t1;
+    const char *map;
+    size_t len, pos, total = 0, n;
+    int32_t day = IDXNODATE;
+    int64_t prev;
+    FILE *fp;
+    int k, status;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    map = IdxMap(fname, &len, &st);
+    if(map == NULL) { return 0; }
+    madvise((void *)map, len, MADV_SEQUENTIAL);
+
+    // Split at sentence starts so no sentence is shared by two chunks
+    for(k = 0, pos = 0; k < nthreads; k++)
+    {
+        chunk[k].map = map;
+        chunk[k].start = pos;
+        pos = (k == nthreads - 1) ? len : len / nthreads * (k + 1);
+        while(pos < len && !(map[pos] == '$' && (pos == 0 || map[pos - 1] == '\n'))) { pos++; }
+        if(pos < chunk[k].start) { pos = chunk[k].start; }
+        chunk[k].end = pos;
+        pthread_create(&chunk[k].thread, NULL, IdxWorker, &chunk[k]);
+    }
+    for(k = 0; k < nthreads; k++)
+    {
+        pthread_join(chunk[k].thread, NULL);
+        total += chunk[k].count;
+    }
+
+    all = (idxentry_s *)malloc((total ? total : 1) * sizeof(idxentry_s));
+    status = (all != NULL);
+
+    // Carry the date into entries that came before the first RMC of their chunk, and step
+    // the day when the time of day wraps at midnight before the next RMC.  Fixes logged
+    // before the first RMC of the whole log take its date.
+    for(k = 0; k < nthreads && day == IDXNODATE; k++) { day = chunk[k].firstday; }
+    for(k = 0, n = 0, prev = -1; k < nthreads && status; k++)
+    {
+        status = !chunk[k].failed;
+        for(pos = 0; pos < chunk[k].count && status; pos++)
+        {
+            idxentry_s *e = &chunk[k].entry[pos];
+
+            if(e->reserved == 0)
+            {
+                if(prev >= 0 && e->time < prev - 43200000) { day++; }
+                prev = e->time;
+                e->time += (day == IDXNODATE ? 0 : (int64_t)day * 86400000);
+            }
+            e->reserved = 0;
+            all[n++] = *e;
+        }
+        if(chunk[k].day != IDXNODATE) { day = chunk[k].day; }
+        if(chunk[k].lasttod >= 0) { prev = chunk[k].lasttod; }
+        free(chunk[k].entry);
+    }
+    munmap((void *)map, len);
+
+    if(status)
+    {
+        qsort(all, total, sizeof(idxentry_s), IdxCompare);
+
+        memset(&hdr, 0, sizeof(hdr));
+        strcpy(hdr.magic, IDXMAGIC);
+        hdr.version = IDXVERSION;
+        hdr.count = total;
+        hdr.logsize = st.st_size;
+        hdr.logmtime = st.st_mtime;
+
+        snprintf(idxname, sizeof(idxname), "%s%s", fname, IDXSUFFIX);
+        fp = fopen(idxname, "wb");
+        status = (fp != NULL) && fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+                 fwrite(all, sizeof(idxentry_s), total, fp) == total;
+        if(fp != NULL) { fclose(fp); }
+
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        printf("%s: %zu GGA fixes from %zu bytes, %d thread(s), %.3f s\n", idxname, total, len,
+               nthreads, (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+    }
+    free(all);
+
+    return status;
+}
+
+/** \brief Map the sidecar index of a log, checking that it matches the log
+ *
+ * \param log file name, returned header, returned length of the mapping
+ * \return const idxentry_s* entries, NULL when missing or stale
+ */
+static const idxentry_s *IdxOpen(const char *fname, idxheader_s *hdr, size_t *maplen)
+{
+    char idxname[4096];
+    struct stat logst, st;
+    const char *map;
+
+    if(stat(fname, &logst) != 0) { return NULL; }
+    snprintf(idxname, sizeof(idxname), "%s%s", fname, IDXSUFFIX);
+    map = IdxMap(idxname, maplen, &st);
+    if(map == NULL) { return NULL; }
+
+    // A truncated index may be shorter than the header itself
+    if(*maplen < sizeof(*hdr))
+    {
+        munmap((void *)map, *maplen);
+        return NULL;
+    }
+
+    memcpy(hdr, map, sizeof(*hdr));
+    if(strncmp(hdr->magic, IDXMAGIC, sizeof(hdr->magic)) != 0 ||
+       hdr->version != IDXVERSION || hdr->logsize != logst.st_size ||
+       hdr->logmtime != logst.st_mtime || hdr->count < 0 ||
+       (uint64_t)hdr->count > (*maplen - sizeof(*hdr)) / sizeof(idxentry_s))
+    {
+        munmap((void *)map, *maplen);
+        return NULL;
+    }
+
+    return (const idxentry_s *)(map + sizeof(*hdr));
+}
+
+/** \brief Parse a UTC time as YYYY-MM-DD or YYYY-MM-DDTHH:MM:SS
+ *
+ * \param string
+ * \return int64_t milliseconds since 1970, -1 on a bad format
+ */
+static int64_t IdxParseTime(const char *s)
+{
+    int y, mo, d, h = 0, mi = 0, sec = 0;
+
+    if(sscanf(s, "%d-%d-%dT%d:%d:%d", &y, &mo, &d, &h, &mi, &sec) < 3) { return -1; }
+    return ((int64_t)IdxDays(y, mo, d) * 86400 + h * 3600 + mi * 60 + sec) * 1000;
+}
+
+/** \brief First entry at or after a time
+ *
+ * \param entries, count, time in milliseconds
+ * \return size_t index
+ */
+static size_t IdxLowerBound(const idxentry_s *e, size_t count, int64_t time)
+{
+    size_t lo = 0, hi = count, mid;
+
+    while(lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if(e[mid].time < time) { lo = mid + 1; }
+        else                   { hi = mid; }
+    }
+    return lo;
+}
+
+/** \brief Sort comparison for int32_t
+ *
+ * \param two int32_t
+ * \return int order
+ */
+static int IdxCompareInt(const void *a, const void *b)
+{
+    int32_t ia = *(const int32_t *)a, ib = *(const int32_t *)b;
+
+    return (ia > ib) - (ia < ib);
+}
+
+/** \brief Print usage
+ *
+ * \param program name
+ * \return int 1
+ */
+static int IdxUsage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s build log [threads]\n"
+                    "       %s info log\n"
+                    "       %s range log YYYY-MM-DDTHH:MM:SS YYYY-MM-DDTHH:MM:SS\n"
+                    "       %s median log YYYY-MM-DD [-a]\n", prog, prog, prog, prog);
+    return 1;
+}
+
+/** \brief Build the index or answer a query from it
+ *
+ * \param int/char* argument count and arguments
+ * \return int 0 on success, 1 on failure
+ */
+int main(int argc, char *argv[])
+{
+    const idxentry_s *e;
+    const char *log, *nl;
+    idxheader_s hdr;
+    struct stat st;
+    size_t idxlen, loglen, i, first, last, n;
+    int64_t from, to;
+    int32_t *lat, *lon;
+    int nthreads, all;
+    time_t secs;
+    char when[32];
+
+    if(argc < 3) { return IdxUsage(argv[0]); }
+
+    if(strcmp(argv[1], "build") == 0)
+    {
+        nthreads = (argc > 3) ? atoi(argv[3]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        if(nthreads < 1) { nthreads = 1; }
+        if(nthreads > IDXMAXTHREADS) { nthreads = IDXMAXTHREADS; }
+        if(!IdxBuild(argv[2], nthreads))
+        {
+            fprintf(stderr, "Cannot index %s\n", argv[2]);
+            return 1;
+        }
+        return 0;
+    }
+
+    e = IdxOpen(argv[2], &hdr, &idxlen);
+    if(e == NULL)
+    {
+        fprintf(stderr, "No up to date index for %s, run: %s build %s\n", argv[2], argv[0], argv[2]);
+        return 1;
+    }
+
+    if(strcmp(argv[1], "info") == 0)
+    {
+        printf("%lld GGA fixes\n", (long long)hdr.count);
+        if(hdr.count > 0)
+        {
+            secs = (time_t)(e[0].time / 1000);
+            strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", gmtime(&secs));
+            printf("first %s\n", when);
+            secs = (time_t)(e[hdr.count - 1].time / 1000);
+            strftime(when, sizeof(when), "%Y-%m-%dT%H:%M:%S", gmtime(&secs));
+            printf("last  %s\n", when);
+        }
+    }
+    else if(strcmp(argv[1], "range") == 0 && argc >= 5)
+    {
+        from = IdxParseTime(argv[3]);
+        to = IdxParseTime(argv[4]);
+        log = IdxMap(argv[2], &loglen, &st);
+        if(from < 0 || to < 0 || log == NULL) { return IdxUsage(argv[0]); }
+
+        first = IdxLowerBound(e, hdr.count, from);
+        last = IdxLowerBound(e, hdr.count, to + 1);
+        for(i = first; i < last; i++)
+        {
+            nl = (const char *)memchr(log + e[i].offset, '\n', loglen - e[i].offset);
+            n = (nl ? (size_t)(nl - log) : loglen) - e[i].offset;
+            if(n > 0 && log[e[i].offset + n - 1] == '\r') { n--; }
+            fwrite(log + e[i].offset, 1, n, stdout);
+            fputc('\n', stdout);
+        }
+        munmap((void *)log, loglen);
+    }
+    else if(strcmp(argv[1], "median") == 0 && argc >= 4)
+    {
+        all = (argc > 4 && strcmp(argv[4], "-a") == 0);
+        from = IdxParseTime(argv[3]);
+        if(from < 0) { return IdxUsage(argv[0]); }
+
+        first = IdxLowerBound(e, hdr.count, from);
+        last = IdxLowerBound(e, hdr.count, from + 86400000);
+        lat = (int32_t *)malloc((last - first + 1) * sizeof(int32_t));
+        lon = (int32_t *)malloc((last - first + 1) * sizeof(int32_t));
+        if(lat == NULL || lon == NULL) { return 1; }
+
+        for(i = first, n = 0; i < last; i++)
+        {
+            if(!all && e[i].quality == 0) { continue; }
+            lat[n] = e[i].latitude;
+            lon[n] = e[i].longitude;
+            n++;
+        }
+        if(n == 0)
+        {
+            printf("no %sfixes on %s\n", all ? "" : "valid ", argv[3]);
+        }
+        else
+        {
+            qsort(lat, n, sizeof(int32_t), IdxCompareInt);
+            qsort(lon, n, sizeof(int32_t), IdxCompareInt);
+            printf("%s: %zu fixes, median latitude %.6f longitude %.6f\n", argv[3], n,
+                   lat[n / 2] / 1e6, lon[n / 2] / 1e6);
+        }
+        free(lat);
+        free(lon);
+    }
+    else
+    {
+        munmap((void *)((const char *)e - sizeof(hdr)), idxlen);
+        return IdxUsage(argv[0]);
+    }
+
+    munmap((void *)((const char *)e - sizeof(hdr)), idxlen);
+    return 0;
+}
@@ -8,6 +8,9 @@
 #include <wiringPi.h>
 #include <wiringPiI2C.h>
 #include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
 #include <pcf8591.h>
 #include "spa.h"
 #include "tsl2561.h"
@@ -17,6 +20,22 @@
 
 
 positiondata_s positiontable[STMAXTBLSZ];
+suntimes_s suntimescache[STRTSCACHESZ];
+int suntimesnext = 0;
+trajtable_s trajtable = {0};
+spa_stepper sunstepper = {0};
+long stazorigin = 0;        // azimuth step, from the feedback, at motion thread position 0
+int stmotion = 0;           // motion thread running, else StSetPanelPosition() steps in place
+pthread_mutex_t stmovelock = PTHREAD_MUTEX_INITIALIZER;    // one StSetPanelPosition() at a time
+pthread_mutex_t sttracklock = PTHREAD_MUTEX_INITIALIZER;    // guards the tracking state below
+pthread_cond_t sttrackwake = PTHREAD_COND_INITIALIZER;      // new calculated position
+pthread_t sttrackthread;
+int sttrackrunning = 0;     // tracking thread started
+int sttrackactive = 0;      // tracking on, cleared by StTrackStop()
+int sttrackpending = 0;     // calculated position not yet taken by the tracking thread
+panelpos_s sttracktarget = {0.0};   // latest calculated position from StTrackSun()
+double stldraz = 0.0;       // LDR offsets added to the calculated position [degrees]
+double stldrel = 0.0;
 
 
 /** \brief Initialise the weather panel
@@ -35,6 +54,11 @@ int StPanelInitialization(void)
     pcf8591Setup(ST_PCF8591_PINBASE, ST_PCF8591_I2CADR);
     WsInit();
 	gps_init();
+#if STUSETRAJ
+	traj_open(&trajtable, STTRAJFILE);
+#endif
+	spa_stepper_init(&sunstepper, SPA_STEP_WINDOW);
+	StTrackStart();
 
 	status = StRetrievePositionTable();
 	if(status == STNOTABLE)
@@ -73,11 +97,19 @@ int StPanelInitialization(void)
  */
 void StServoSetup(void)
 {
+#if STUSEMOTION
+    // STPWMDELAY is the settle time allowed for a full swing, it paces the servo axis
+    motionservo_s servo = {STELPIN, MOTIONNOPWM, STPWMMAX-STPWMMIN, STPWMDELAY/1000.0};
+#endif
+
     //Hardware PWM for elevation
     pinMode(STELPIN,PWM_OUTPUT);
     pwmSetMode(PWM_MODE_MS);
     pwmSetClock(STPWMCLOCK);
     pwmSetRange(STPWMRANGE);
+#if STUSEMOTION
+    motion_attach_servo(&servo);
+#endif
 }
 
 /** \brief Initialise the stepper motor
@@ -89,8 +121,16 @@ void StServoSetup(void)
  */
 void StStepperSetup(void)
 {
+#if STUSEMOTION
+    motionprofile_s profile = {STSTEPSTART, STSTEPMAXRATE, STSTEPACCEL};
+#endif
+
     pinMode(STAZSTEP,OUTPUT);
     pinMode(STAZDIR,OUTPUT);
+#if STUSEMOTION
+    stmotion = motion_start(STAZSTEP, STAZDIR, &profile);
+    if(!stmotion) { fprintf(stderr, "Motion thread did not start, stepping in place\n"); }
+#endif
 }
 
 
@@ -125,7 +165,10 @@ panelpos_s StGetPanelPosition(void)
 void StSetPanelPosition(panelpos_s newpos)
 {
     panelpos_s cpos = StGetPanelPosition();
-    int pwmnel, pwmnaz, stepnaz, stepcaz, dir, i;
+    int pwmnel, pwmnaz, stepnaz, stepcaz;
+#if STUSEMOTION
+    motionstatus_s status;
+#endif
 
     //pwmnel = (int) (newpos.Elevation / STSERVORANGE  * (STPWMMAX-STPWMMIN)) + STPWMMIN;
     //pwmnaz = (int) (newpos.Azimuth / STSTEPRANGE * (STPWMMAX-STPWMMIN))+STPWMMIN;
@@ -133,12 +176,31 @@ void StSetPanelPosition(panelpos_s newpos)
 	pwmnel = positiontable[(int)newpos.Elevation].pwm;
 	pwmnaz = positiontable[(int)newpos.Azimuth].cnt;
 
-    pwmWrite(STELPIN,pwmnel);
-    delay(STPWMDELAY);
-
     stepnaz = (int)((STMAXAZ - newpos.Azimuth)/STSTEPRANGE*(STSTEPMAX-STSTEPMIN))+STSTEPMIN;
     stepcaz = (int)((STMAXAZ - cpos.Azimuth)/STSTEPRANGE*(STSTEPMAX-STSTEPMIN))+STSTEPMIN;
 
+#if STUSEMOTION
+    // The feedback lags a move in progress, so the move is taken from the commanded position.
+    // While the stepper is idle the feedback re-anchors the motion thread's step count, which
+    // corrects any steps it lost.  The thread picks up a new target once the current move ends.
+    if(stmotion)
+    {
+        pthread_mutex_lock(&stmovelock);
+        status = motion_get_status();
+        if(!status.busy) { stazorigin = stepcaz - status.position; }
+        motion_move_axes(stepnaz - (stazorigin + status.target), pwmnel, STSYNCAXES);
+        pthread_mutex_unlock(&stmovelock);
+        return;
+    }
+#endif
+    // Without the motion thread, move the servo, then step the azimuth in place
+    int dir, i;
+
+    pthread_mutex_lock(&stmovelock);
+
+    pwmWrite(STELPIN,pwmnel);
+    delay(STPWMDELAY);
+
     dir = ((stepnaz-stepcaz)<0) ? LOW : HIGH;
 
     digitalWrite(STAZDIR,dir);
@@ -150,6 +212,7 @@ void StSetPanelPosition(panelpos_s newpos)
         delay(STSTEPDELAY);
         digitalWrite(STAZSTEP,LOW);
     }
+    pthread_mutex_unlock(&stmovelock);
 }
 
 
@@ -278,6 +341,74 @@ int StSavePositionTable(void){
 	return 1;
 }
 
+/** \brief Get the site used for the sun position
+ *
+ * The surveyed site once locked, else the latest fix from the GPS thread.  Stale or
+ * imprecise fixes fall back to the default site.
+ *
+ * \param void
+ * \return structure loc_t with the site
+ */
+loc_t StGetSite(void)
+{
+    gpsfix_s gpsfix;
+    gpssite_s gpssite;
+    loc_t site = {0};
+
+    if(gps_get_site(&gpssite))
+    {
+        site.latitude = gpssite.latitude;
+        site.longitude = gpssite.longitude;
+        site.altitude = gpssite.altitude;
+    }
+    else if(gps_get_fix(&gpsfix) && gps_fix_usable(&gpsfix))
+    {
+        site = gpsfix.loc;
+    }
+
+    if(site.latitude == 0 || site.longitude == 0)
+    {
+        site.latitude = DLATITUDE;
+        site.longitude = DLONGITUDE;
+        site.altitude = PELEVATION;
+    }
+
+    return site;
+}
+
+/** \brief Fill a spa_data structure with the local time, site and atmosphere for SPA_ZA_INC
+ *
+ * \param spa_data structure to fill, time, site
+ * \return void
+ */
+void StSetupSpaData(spa_data *csp, time_t rawtime, loc_t site)
+{
+    struct tm *ct;
+
+    // Get time in a suitable format for assigning to a spa_data structure
+    ct = localtime(&rawtime);
+
+    memset(csp, 0, sizeof(*csp));
+    csp->year           = ct->tm_year+1900;
+    csp->month          = ct->tm_mon+1;
+    csp->day            = ct->tm_mday;
+    csp->hour           = ct->tm_hour;
+    csp->minute         = ct->tm_min;
+    csp->second         = ct->tm_sec;
+    csp->timezone       = DTIMEZONE;
+    csp->delta_ut1      = DELTAUT1;
+    csp->delta_t        = DELTAT;
+    csp->longitude      = site.longitude;
+    csp->latitude       = site.latitude;
+    csp->elevation      = site.altitude;
+    csp->pressure       = WsGetPressure();
+    csp->temperature    = WsGetTemperature();
+    csp->slope          = DSLOPE;
+    csp->azm_rotation   = DAZROT;
+    csp->atmos_refract  = DATMREF;
+    csp->function       = SPA_ZA_INC;
+}
+
 /** \brief Use spa functions to return a calculated panel position
  *
  * \param void
@@ -288,57 +419,261 @@ int StSavePositionTable(void){
 panelpos_s StCalculateNewPanelPosition(void)
 {
     panelpos_s newpos = {0.0};
-    spa_data csp  = {0.0};
+    spa_data csp;
     time_t rawtime;
-    struct tm *ct;
-    loc_t gpspos = {0};
+    loc_t site;
+    double azimuth, zenith, incidence;
 
-    // Get time in a suitable format for assigning to a spa_data structure
     time(&rawtime);
-    ct = localtime(&rawtime);
-	gpspos = gps_location();
-
-    // Set up spa_data structure for calculation
-    csp.year            = ct->tm_year+1900;
-    csp.month           = ct->tm_mon+1;
-    csp.day             = ct->tm_mday;
-    csp.hour            = ct->tm_hour;
-    csp.minute          = ct->tm_min;
-    csp.second          = ct->tm_sec;
-    csp.timezone        = DTIMEZONE;
-    csp.delta_ut1       = DELTAUT1;
-    csp.delta_t         = DELTAT;
-    if(gpspos.latitude != 0 && gpspos.longitude != 0)
-    {
-        csp.longitude  = gpspos.longitude;
-        csp.latitude   = gpspos.latitude;
-        csp.elevation  = gpspos.altitude;
-        newpos.gpsdata = gpspos;
-    }
-    else
+    site = StGetSite();
+    newpos.gpsdata = site;
+
+#if STUSETRAJ
+    // Answer from the precomputed trajectory when it covers this site and time, before any
+    // SPA work or weather sensor reads
+    if(traj_matches_site(&trajtable, site.latitude, site.longitude) &&
+       traj_lookup(&trajtable, rawtime, &azimuth, &zenith, &incidence))
     {
-        csp.longitude  = DLONGITUDE;
-        csp.latitude   = DLATITUDE;
-        csp.elevation  = PELEVATION;
-        newpos.gpsdata.latitude = csp.latitude;
-        newpos.gpsdata.longitude = csp.longitude;
+        newpos.Azimuth = azimuth;
+        newpos.Elevation = 90.0 - incidence;
+        return newpos;
     }
-    csp.pressure        = WsGetPressure();
-    csp.temperature     = WsGetTemperature();
-    csp.slope           = DSLOPE;
-    csp.azm_rotation    = DAZROT;
-    csp.atmos_refract   = DATMREF;
-    csp.function        = SPA_ALL;
+#endif
 
+    // Set up spa_data structure for calculation, rise/transit/set are left to StGetSunTimes()
+    StSetupSpaData(&csp, rawtime, site);
 
-    spa_calculate(&csp);
+    // Consecutive ticks are seconds apart, so the slowly varying terms come from the stepper
+#if STSPAFLOAT
+    spa_calculate_float(&csp);
+#else
+    spa_calculate_step(&csp, &sunstepper);
+#endif
     newpos.Azimuth = csp.azimuth;
     newpos.Elevation = 90.0 - csp.incidence;
 
     return newpos;
 }
 
+/** \brief Get the sun rise/transit/set times for the date and site of a spa_data structure
+ *
+ * Times are calculated with SPA_ZA_RTS the first time a date and site is seen and then
+ * served from a small cache.  The site is keyed to STRTSSITERES and the altitude is
+ * ignored, so successive GPS fixes at one site share an entry.
+ *
+ * \param spa_data structure with the date, time zone, site and atmosphere filled in
+ * \return structure suntimes_s with the times for that date and site
+ */
+suntimes_s StLookupSunTimes(const spa_data *csp)
+{
+    spa_data rts;
+    suntimes_s *entry;
+    long latkey = lround(csp->latitude / STRTSSITERES);
+    long lonkey = lround(csp->longitude / STRTSSITERES);
+    int i;
+
+    for(i = 0; i < STRTSCACHESZ; i++)
+    {
+        entry = &suntimescache[i];
+        if(entry->valid && entry->year == csp->year && entry->month == csp->month &&
+           entry->day == csp->day && entry->latkey == latkey && entry->lonkey == lonkey &&
+           entry->timezone == csp->timezone)
+        {
+            return *entry;
+        }
+    }
+
+    rts = *csp;
+    rts.function = SPA_ZA_RTS;
+    entry = &suntimescache[suntimesnext];
+    entry->valid = 1;
+    entry->year = csp->year;
+    entry->month = csp->month;
+    entry->day = csp->day;
+    entry->latkey = latkey;
+    entry->lonkey = lonkey;
+    entry->timezone = csp->timezone;
+
+    if(spa_calculate(&rts) == 0)
+    {
+        entry->sunrise = rts.sunrise;
+        entry->suntransit = rts.suntransit;
+        entry->sunset = rts.sunset;
+        entry->eot = rts.eot;
+    }
+    else
+    {
+        entry->sunrise = entry->suntransit = entry->sunset = STNORTS;
+        entry->eot = 0.0;
+    }
+
+    suntimesnext = (suntimesnext + 1) % STRTSCACHESZ;
+
+    return *entry;
+}
+
+/** \brief Get today's sun rise/transit/set times at the tracker site, for the HMI
+ *
+ * Only calculated when asked for, the control tick does not need them.
+ *
+ * \param void
+ * \return structure suntimes_s with the times, STNORTS where the sun does not rise or set
+ */
+suntimes_s StGetSunTimes(void)
+{
+    spa_data csp;
+    time_t rawtime;
+
+    time(&rawtime);
+    StSetupSpaData(&csp, rawtime, StGetSite());
+
+    return StLookupSunTimes(&csp);
+}
+
+/** \brief Move to a calculated position plus the LDR offsets
+ *
+ * \param calculated panelpos_s structure
+ * \return void
+ */
+void StTrackMove(panelpos_s target)
+{
+    pthread_mutex_lock(&sttracklock);
+    target.Azimuth += stldraz;
+    target.Elevation += stldrel;
+    pthread_mutex_unlock(&sttracklock);
+
+    StSetPanelPosition(target);
+}
+
+/** \brief Check whether a tracking pass should end before its next LDR correction
+ *
+ * \param void
+ * \return int 1 if a newer position is waiting or tracking was stopped, 0 otherwise
+ */
+int StTrackSuperseded(void)
+{
+    int superseded;
+
+    pthread_mutex_lock(&sttracklock);
+    superseded = sttrackpending || !sttrackactive;
+    pthread_mutex_unlock(&sttracklock);
+
+    return superseded;
+}
+
+/** \brief Move to a calculated position, then correct it from the LDR sensor data
+ *
+ * Up to STLDRSTEPS corrections are taken, each read where the previous move ended.  The
+ * corrections build up offsets, within STLDRMAXOFFSET, that are kept for the following
+ * positions.  The pass ends
+ * early when a move does not end within STMOVEWAIT, a newer position arrives or tracking
+ * is stopped; the offsets found so far are kept.
+ *
+ * \param calculated panelpos_s structure
+ * \return void
+ */
+void StTrackPass(panelpos_s target)
+{
+    ldrsensor_s spos = {0};
+    int i;
+
+    // Park at night, the offsets are found again from the morning sun
+    if(target.Elevation <= 0.0)
+    {
+        pthread_mutex_lock(&sttracklock);
+        stldraz = 0.0;
+        stldrel = 0.0;
+        pthread_mutex_unlock(&sttracklock);
+        target.Azimuth = PAZIMUTH;
+        target.Elevation = PELEVATION;
+        StSetPanelPosition(target);
+        return;
+    }
+
+    StTrackMove(target);
+    for(i=0; i<STLDRSTEPS; i++)
+    {
+#if STUSEMOTION
+        // Read the LDRs where the last move ended
+        if(!motion_wait(STMOVEWAIT)) { return; }
+#endif
+        if(StTrackSuperseded()) { return; }
+
+        // Adjust panel postion using LDR data
+        spos = StGetLdrReadings();
+        pthread_mutex_lock(&sttracklock);
+        if(spos.eset < STSECTR - 10) {stldrel++;}
+        if(spos.eset > STSECTR + 10) {stldrel--;}
+        if(spos.aset < STSACTR - 10) {stldraz--;}
+        if(spos.aset > STSACTR + 10) {stldraz++;}
+        stldraz = fmax(-STLDRMAXOFFSET, fmin(STLDRMAXOFFSET, stldraz));
+        stldrel = fmax(-STLDRMAXOFFSET, fmin(STLDRMAXOFFSET, stldrel));
+        pthread_mutex_unlock(&sttracklock);
+        StTrackMove(target);
+    }
+}
+
+/** \brief Tracking thread, runs a pass for each position calculated by StTrackSun()
+ *
+ * A position that arrives during a pass replaces any older one still waiting.
+ *
+ * \param unused
+ * \return NULL
+ */
+void *StTrackRun(void *arg)
+{
+    panelpos_s target;
+
+    (void)arg;
+    pthread_mutex_lock(&sttracklock);
+    while(1)
+    {
+        while(!sttrackpending) { pthread_cond_wait(&sttrackwake, &sttracklock); }
+        target = sttracktarget;
+        sttrackpending = 0;
+        pthread_mutex_unlock(&sttracklock);
+
+        StTrackPass(target);
+
+        pthread_mutex_lock(&sttracklock);
+    }
+
+    return NULL;
+}
+
+/** \brief Start the tracking thread, so StTrackSun() never waits for the panel
+ *
+ * \param void
+ * \return int 1 if the thread is running, 0 if StTrackSun() has to run each pass itself
+ */
+int StTrackStart(void)
+{
+    if(sttrackrunning) { return 1; }
+
+    sttrackrunning = (pthread_create(&sttrackthread, NULL, StTrackRun, NULL) == 0);
+    if(!sttrackrunning) { fprintf(stderr, "Tracking thread did not start, tracking from the HMI\n"); }
+
+    return sttrackrunning;
+}
+
+/** \brief Stop tracking, a pass in progress ends before its next LDR correction
+ *
+ * \param void
+ * \return void
+ */
+void StTrackStop(void)
+{
+    pthread_mutex_lock(&sttracklock);
+    sttrackactive = 0;
+    sttrackpending = 0;
+    pthread_mutex_unlock(&sttracklock);
+}
+
 /** \brief Uses calculated panel position to set the panel position, then adjusts panel position using LDR sensor data
+ *
+ * The sun position is calculated on every call and handed to the tracking thread, which
+ * moves the panel there plus the LDR offsets and then runs the LDR corrections, so the HMI
+ * thread never waits for a move.
  *
  * \param void
  * \return structure panelpos_s with position data
@@ -348,33 +683,34 @@ panelpos_s StCalculateNewPanelPosition(void)
 panelpos_s StTrackSun(void)
 {
     panelpos_s tpos = {0.0};
-    ldrsensor_s spos = {0};
-    int i;
+    panelpos_s target;
 
-    // Move the panel to the calculated position
+    // Calculated position
     tpos = StCalculateNewPanelPosition();
     tpos.Elevation = tpos.Elevation + 90.0;
-    if(tpos.Elevation <= 0.0)
-    {
-        tpos.Azimuth = PAZIMUTH;
-        tpos.Elevation = PELEVATION;
-        StSetPanelPosition(tpos);
-        return tpos;
-    }
-    else
+    target = tpos;
+
+    pthread_mutex_lock(&sttracklock);
+    sttrackactive = 1;
+    sttracktarget = target;
+    sttrackpending = sttrackrunning;
+    pthread_cond_signal(&sttrackwake);
+    if(tpos.Elevation > 0.0)
     {
-        StSetPanelPosition(tpos);
+        tpos.Azimuth += stldraz;
+        tpos.Elevation += stldrel;
     }
-    // Adjust panel postion using LDR data
-    for(i=0; i<10; i++)
+    pthread_mutex_unlock(&sttracklock);
+
+    // Without the thread the pass runs here and blocks the HMI, as it always did
+    if(!sttrackrunning) { StTrackPass(target); }
+
+    if(target.Elevation <= 0.0)
     {
-        spos = StGetLdrReadings();
-        if(spos.eset < STSECTR - 10) {tpos.Elevation++;}
-        if(spos.eset > STSECTR + 10) {tpos.Elevation--;}
-        if(spos.aset < STSACTR - 10) {tpos.Azimuth--;}
-        if(spos.aset > STSACTR + 10) {tpos.Azimuth++;}
-        StSetPanelPosition(tpos);
+        tpos.Azimuth = PAZIMUTH;
+        tpos.Elevation = PELEVATION;
     }
+
     return tpos;
 }
 
@@ -7,6 +7,10 @@
 #define PANEL_H
 #include "wxstn.h"
 #include "gps.h"
+#include "spa.h"
+#include "spaf.h"
+#include "traj.h"
+#include "motion.h"
 
 // Panel Position Constants
 
@@ -46,6 +50,14 @@
 #define STSTEPMAX   1000
 #define STSTEPMIN   0
 #define STSTEPDELAY 1
+#define STUSEMOTION 1           // 1 steps from the motion thread with ramps, 0 (or a failed thread start) blocks in a fixed rate loop
+#define STSTEPSTART 1000.0      // rate of the first and last step, the old fixed rate [steps/s]
+#define STSTEPMAXRATE 5000.0    // slew rate [steps/s]
+#define STSTEPACCEL 20000.0     // ramp acceleration [steps/s^2]
+#define STSYNCAXES 0            // 1 makes the servo and stepper arrive together, 0 lets each go at its own speed
+#define STLDRSTEPS 10           // LDR corrections after each move to a calculated position
+#define STLDRMAXOFFSET 10.0     // largest LDR offset from the calculated position, the reach of one pass [degrees]
+#define STMOVEWAIT 2000         // tracking thread wait for a move to end before reading the LDRs [ms]
 
 // Position Feedback Constants
 #define STPE000     45.0        // Low end offset by 30 degrees
@@ -86,6 +98,18 @@
 #define STLEDMIN 0
 #define STLEDMAX 255
 
+// Trajectory table constants
+#define STUSETRAJ   1
+#define STTRAJFILE  "trajectory.dat"
+
+// Sun position precision, 1 uses the float SPA (about 0.001 degrees, 2000 to 2100)
+#define STSPAFLOAT  0
+
+// Sun rise/transit/set cache constants
+#define STRTSCACHESZ 4
+#define STRTSSITERES 0.01       // site resolution of the cache key [degrees]
+#define STNORTS -99999.0
+
 
 
 // Data structures
@@ -110,6 +134,21 @@ typedef struct positiondata
 	int pwm;	///< Elevation pwm value
 } positiondata_s;
 
+typedef struct suntimes
+{
+    int valid;          ///< Entry has been calculated
+    int year;           ///< Local date of the entry
+    int month;
+    int day;
+    long latkey;        ///< Site of the entry in STRTSSITERES steps
+    long lonkey;
+    double timezone;
+    double sunrise;     ///< Local sunrise time [fractional hour], STNORTS if none
+    double suntransit;  ///< Local solar noon [fractional hour], STNORTS if none
+    double sunset;      ///< Local sunset time [fractional hour], STNORTS if none
+    double eot;         ///< Equation of time when the entry was calculated [minutes]
+} suntimes_s;
+
 typedef struct paneldata
 {
     double azimuth;
@@ -131,6 +170,14 @@ int StSavePositionTable(void);
 int StRetrievePositionTable(void);
 void StSetCalibrationLED(unsigned short);
 int StLogPanelData(paneldata_s pdata, reading_s creads);
+loc_t StGetSite(void);
+void StSetupSpaData(spa_data *csp, time_t rawtime, loc_t site);
+suntimes_s StLookupSunTimes(const spa_data *csp);
+suntimes_s StGetSunTimes(void);
+panelpos_s StCalculateNewPanelPosition(void);
+int StTrackStart(void);
+void StTrackStop(void);
+panelpos_s StTrackSun(void);
 
 
 #endif // PANEL_H
@@ -11,21 +11,68 @@
 #include <termios.h>
 #include <inttypes.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/uio.h>
 
 #include "serial.h"
 
 int uart0_filestream = -1;
 
+// Bytes received but not yet returned as a line
+static char rxbuf[SERIALBUFSZ];
+static int rxlen = 0;
+static serialstats_s rxstats = {0};
+
+// Transmit ring, filled by serial_println() and drained by the writer thread.  The head and
+// tail only grow, the ring index is their value modulo SERIALTXSZ.
+static char txbuf[SERIALTXSZ];
+static size_t txhead = 0;       // next byte to write, advanced by the writer
+static size_t txtail = 0;       // next free byte, advanced by serial_println()
+static serialstats_s txstats = {0};
+static pthread_mutex_t txlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t txwake = PTHREAD_COND_INITIALIZER;       // lines queued or stopping
+static pthread_cond_t txdrained = PTHREAD_COND_INITIALIZER;    // ring emptied
+static pthread_t txthread;
+static int txrunning = 0;
+
+static void *SerialWriter(void *);
+
 void serial_init(void)
 {
-    uart0_filestream = open(PORTNAME, O_RDWR | O_NOCTTY | O_NDELAY);
-
-    if (uart0_filestream == -1)
+    if (serial_open(PORTNAME) == -1)
     {
         //TODO error handling...
     }
 }
 
+/** \brief Open a serial device, or the slave side of a pseudo-terminal when testing
+ *
+ * \param device path
+ * \return int file descriptor, -1 on failure
+ */
+int serial_open(const char *port)
+{
+    uart0_filestream = open(port, O_RDWR | O_NOCTTY | O_NDELAY);
+    rxlen = 0;
+    memset(&rxstats, 0, sizeof(rxstats));
+    if (uart0_filestream == -1) { return -1; }
+
+    pthread_mutex_lock(&txlock);
+    txhead = txtail = 0;
+    memset(&txstats, 0, sizeof(txstats));
+    if (!txrunning)
+    {
+        txrunning = 1;
+        if (pthread_create(&txthread, NULL, SerialWriter, NULL) != 0) { txrunning = 0; }
+    }
+    pthread_mutex_unlock(&txlock);
+
+    return uart0_filestream;
+}
+
 void serial_config(void)
 {
     struct termios options;
@@ -38,53 +85,380 @@ void serial_config(void)
     tcsetattr(uart0_filestream, TCSANOW, &options);
 }
 
-void serial_println(const char *line, int len)
+/** \brief Change the UART speed once the queued lines have gone out
+ *
+ * Data received at the old speed is discarded, it cannot be decoded at the new one.
+ *
+ * \param baud rate, 9600 to 230400
+ * \return int 1 on success, 0 for an unsupported rate or a UART error
+ */
+int serial_set_baud(long baud)
+{
+    struct termios options;
+    speed_t speed;
+
+    switch (baud)
+    {
+        case 9600: speed = B9600; break;
+        case 19200: speed = B19200; break;
+        case 38400: speed = B38400; break;
+        case 57600: speed = B57600; break;
+        case 115200: speed = B115200; break;
+        case 230400: speed = B230400; break;
+        default: return 0;
+    }
+    if (uart0_filestream == -1) { return 0; }
+
+    // A command changing the receiver's speed must leave at the old one
+    serial_tx_flush(SERIALTXFLUSH);
+    tcdrain(uart0_filestream);
+
+    if (tcgetattr(uart0_filestream, &options) != 0) { return 0; }
+    cfsetispeed(&options, speed);
+    cfsetospeed(&options, speed);
+    if (tcsetattr(uart0_filestream, TCSANOW, &options) != 0) { return 0; }
+    serial_discard();
+
+    return 1;
+}
+
+/** \brief Drop everything received and not yet read
+ *
+ * \param void
+ * \return void
+ */
+void serial_discard(void)
+{
+    if (uart0_filestream != -1) { tcflush(uart0_filestream, TCIFLUSH); }
+    rxlen = 0;
+}
+
+/** \brief Writer thread, sends everything queued in the ring with one gathered write
+ *
+ * \param unused
+ * \return NULL
+ */
+static void *SerialWriter(void *arg)
 {
-    if (uart0_filestream != -1)
-	{
-        char *cpstr = (char *)malloc((len+1) * sizeof(char));
-        strcpy(cpstr, line);
-        cpstr[len-1] = '\r';
-        cpstr[len] = '\n';
-
-        int count = write(uart0_filestream, cpstr, len+1);
-        if (count < 0)
-		{
-            //TODO: handle errors...
+    struct iovec iov[2];
+    struct pollfd pfd;
+    size_t head, queued, first;
+    ssize_t n;
+    int iovcnt;
+
+    (void)arg;
+    pthread_mutex_lock(&txlock);
+    while (1)
+    {
+        while (txrunning && txhead == txtail) { pthread_cond_wait(&txwake, &txlock); }
+        if (!txrunning) { break; }
+
+        head = txhead;
+        queued = txtail - txhead;
+        pthread_mutex_unlock(&txlock);
+
+        // The queued bytes are one segment, or two when they wrap around the ring
+        first = head & (SERIALTXSZ - 1);
+        iov[0].iov_base = txbuf + first;
+        iov[0].iov_len = (queued < SERIALTXSZ - first) ? queued : SERIALTXSZ - first;
+        iov[1].iov_base = txbuf;
+        iov[1].iov_len = queued - iov[0].iov_len;
+        iovcnt = (iov[1].iov_len > 0) ? 2 : 1;
+
+        n = writev(uart0_filestream, iov, iovcnt);
+        if (n < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            pfd.fd = uart0_filestream;
+            pfd.events = POLLOUT;
+            poll(&pfd, 1, SERIALTXRETRY);
+            pthread_mutex_lock(&txlock);
+            continue;
         }
-        free(cpstr);
+
+        pthread_mutex_lock(&txlock);
+        if (n < 0)
+        {
+            txstats.txerrors++;
+            n = queued;
+        }
+        else
+        {
+            txstats.txwrites++;
+            txstats.txbytes += n;
+        }
+        txhead += n;
+        if (txhead == txtail) { pthread_cond_broadcast(&txdrained); }
     }
+    pthread_mutex_unlock(&txlock);
+
+    return NULL;
 }
 
-// Read a line from UART.
-// Return a 0 len string in case of problems with UART
-void serial_readln(char *buffer, int len)
+/** \brief Queue a line for transmission, "\r\n" is appended
+ *
+ * The line is copied into the transmit ring and sent by the writer thread, so the caller
+ * never allocates or waits for the UART.
+ *
+ * \param line, number of characters without a line end
+ * \return int 1 if queued, 0 if the ring is full or the UART is not open
+ */
+int serial_println(const char *line, int len)
+{
+    static const char crlf[2] = {'\r', '\n'};
+    size_t need = (size_t)len + 2, tail, first, queued;
+
+    if (uart0_filestream == -1 || len < 0) { return 0; }
+
+    pthread_mutex_lock(&txlock);
+    if (!txrunning || need > SERIALTXSZ - (txtail - txhead))
+    {
+        txstats.txdropped++;
+        pthread_mutex_unlock(&txlock);
+        return 0;
+    }
+
+    tail = txtail & (SERIALTXSZ - 1);
+    first = ((size_t)len < SERIALTXSZ - tail) ? (size_t)len : SERIALTXSZ - tail;
+    memcpy(txbuf + tail, line, first);
+    memcpy(txbuf, line + first, len - first);
+    tail = (txtail + len) & (SERIALTXSZ - 1);
+    txbuf[tail] = crlf[0];
+    txbuf[(tail + 1) & (SERIALTXSZ - 1)] = crlf[1];
+    txtail += need;
+
+    txstats.txlines++;
+    queued = txtail - txhead;
+    if (queued > txstats.txhighwater) { txstats.txhighwater = queued; }
+    pthread_cond_signal(&txwake);
+    pthread_mutex_unlock(&txlock);
+
+    return 1;
+}
+
+/** \brief Wait until the queued lines have been written
+ *
+ * \param timeout in milliseconds (negative waits forever)
+ * \return int 1 if the ring is empty, 0 on timeout
+ */
+int serial_tx_flush(int timeout)
+{
+    struct timespec deadline;
+    int status = 0;
+
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (timeout % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&txlock);
+    while (txrunning && txhead != txtail && status == 0)
+    {
+        if (timeout < 0) { pthread_cond_wait(&txdrained, &txlock); }
+        else { status = pthread_cond_timedwait(&txdrained, &txlock, &deadline); }
+    }
+    status = (txhead == txtail);
+    pthread_mutex_unlock(&txlock);
+
+    return status;
+}
+
+/** \brief Milliseconds on the monotonic clock
+ *
+ * \param void
+ * \return double milliseconds
+ */
+static double SerialNow(void)
 {
-    char c;
-    char *b = buffer;
-    int rx_length = -1;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+/** \brief Read a line from the UART, waiting at most timeout milliseconds
+ *
+ * Data is read in bulk into a receive buffer and lines are handed out from it, so one
+ * read() usually serves several sentences.  The line is returned without the '\n'.
+ *
+ * \param buffer, buffer size, timeout in milliseconds (negative waits forever)
+ * \return int line length, 0 with an empty string on timeout, -1 on a UART error
+ */
+int serial_readln_timeout(char *buffer, int len, int timeout)
+{
+    struct pollfd pfd;
+    double start = SerialNow();
+    double wait;
+    char *nl;
+    int n, linelen, copylen, remaining;
+
+    buffer[0] = '\0';
+    if (uart0_filestream == -1 || len < 1) { return -1; }
+
     while(1)
-	{
-        rx_length = read(uart0_filestream, (void*)(&c), 1);
-
-        if (rx_length <= 0)
-		{
-            //wait for messages
-            sleep(1);
-        } else
-		{
-            if (c == '\n')
-			{
-                *b++ = '\0';
-                break;
+    {
+        nl = (char *)memchr(rxbuf, '\n', rxlen);
+        if (nl != NULL)
+        {
+            linelen = (int)(nl - rxbuf);
+            copylen = (linelen < len) ? linelen : len - 1;
+            if (copylen < linelen) { rxstats.overruns++; }
+            memcpy(buffer, rxbuf, copylen);
+            buffer[copylen] = '\0';
+            rxlen -= linelen + 1;
+            memmove(rxbuf, nl + 1, rxlen);
+
+            wait = SerialNow() - start;
+            rxstats.lines++;
+            rxstats.waitms += wait;
+            if (wait > rxstats.maxwaitms) { rxstats.maxwaitms = wait; }
+            return copylen;
+        }
+
+        // A full buffer without a line end is noise, drop it
+        if (rxlen == SERIALBUFSZ)
+        {
+            rxstats.overruns++;
+            rxlen = 0;
+        }
+
+        remaining = -1;
+        if (timeout >= 0)
+        {
+            remaining = timeout - (int)(SerialNow() - start);
+            if (remaining <= 0)
+            {
+                rxstats.timeouts++;
+                return 0;
             }
-            *b++ = c;
         }
+
+        pfd.fd = uart0_filestream;
+        pfd.events = POLLIN;
+        n = poll(&pfd, 1, remaining);
+        if (n < 0)
+        {
+            if (errno == EINTR) { continue; }
+            return -1;
+        }
+        if (n == 0) { continue; }
+
+        n = read(uart0_filestream, rxbuf + rxlen, SERIALBUFSZ - rxlen);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR) { continue; }
+            return -1;
+        }
+        if (n == 0) { return -1; }     // hung up
+        rxstats.reads++;
+        rxstats.bytes += n;
+        rxlen += n;
     }
 }
 
+/** \brief Read raw bytes from the UART for binary protocols, waiting at most timeout ms
+ *
+ * Bytes already received by serial_readln_timeout() are returned first.
+ *
+ * \param buffer, buffer size, timeout in milliseconds (negative waits forever)
+ * \return int number of bytes, 0 on timeout, -1 on a UART error
+ */
+int serial_read_timeout(char *buffer, int len, int timeout)
+{
+    struct pollfd pfd;
+    int n;
+
+    if (uart0_filestream == -1 || len < 1) { return -1; }
+
+    if (rxlen > 0)
+    {
+        n = (rxlen < len) ? rxlen : len;
+        memcpy(buffer, rxbuf, n);
+        rxlen -= n;
+        memmove(rxbuf, rxbuf + n, rxlen);
+        return n;
+    }
+
+    while(1)
+    {
+        pfd.fd = uart0_filestream;
+        pfd.events = POLLIN;
+        n = poll(&pfd, 1, timeout);
+        if (n < 0)
+        {
+            if (errno == EINTR) { continue; }
+            return -1;
+        }
+        if (n == 0)
+        {
+            rxstats.timeouts++;
+            return 0;
+        }
+
+        n = read(uart0_filestream, buffer, len);
+        if (n < 0)
+        {
+            if (errno == EAGAIN || errno == EINTR) { continue; }
+            return -1;
+        }
+        if (n == 0) { return -1; }     // hung up
+        rxstats.reads++;
+        rxstats.bytes += n;
+        return n;
+    }
+}
+
+// Read a line from UART.
+// Return a 0 len string in case of problems with UART or when no line arrives in time
+void serial_readln(char *buffer, int len)
+{
+    serial_readln_timeout(buffer, len, SERIALTIMEOUT);
+}
+
+/** \brief Get the receive and transmit counters
+ *
+ * \param void
+ * \return serialstats_s structure
+ */
+serialstats_s serial_get_stats(void)
+{
+    serialstats_s stats = rxstats;
+
+    pthread_mutex_lock(&txlock);
+    stats.txlines = txstats.txlines;
+    stats.txdropped = txstats.txdropped;
+    stats.txwrites = txstats.txwrites;
+    stats.txbytes = txstats.txbytes;
+    stats.txerrors = txstats.txerrors;
+    stats.txqueued = txtail - txhead;
+    stats.txhighwater = txstats.txhighwater;
+    pthread_mutex_unlock(&txlock);
+
+    return stats;
+}
+
 void serial_close(void)
 {
-    close(uart0_filestream);
+    // Give queued lines, such as a receiver command, a chance to go out first
+    serial_tx_flush(SERIALTXFLUSH);
+
+    pthread_mutex_lock(&txlock);
+    if (txrunning)
+    {
+        txrunning = 0;
+        pthread_cond_broadcast(&txwake);
+        pthread_mutex_unlock(&txlock);
+        pthread_join(txthread, NULL);
+    }
+    else
+    {
+        pthread_mutex_unlock(&txlock);
+    }
+
+    if (uart0_filestream != -1) { close(uart0_filestream); }
+    uart0_filestream = -1;
 }
 
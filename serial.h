@@ -13,10 +13,43 @@
 #define PORTNAME "/dev/ttyS0"
 #endif
 
+#define SERIALBUFSZ 1024        // receive buffer, holds several NMEA sentences
+#define SERIALTIMEOUT 1000      // serial_readln() deadline [ms]
+#define SERIALTXSZ 4096         // transmit ring, must be a power of two
+#define SERIALTXFLUSH 500       // serial_close() wait for queued lines [ms]
+#define SERIALTXRETRY 100       // writer wait for a full UART to accept data [ms]
+
+// Receive and transmit counters, waits are from the call to the line being returned
+typedef struct serialstats
+{
+    unsigned long reads;        // read() calls that returned data
+    unsigned long bytes;        // bytes received
+    unsigned long lines;        // lines returned
+    unsigned long timeouts;     // calls that reached their deadline
+    unsigned long overruns;     // lines cut to the caller's buffer or dropped when too long
+    double waitms;              // total wait for returned lines [ms]
+    double maxwaitms;           // longest wait for a returned line [ms]
+
+    unsigned long txlines;      // lines queued by serial_println()
+    unsigned long txdropped;    // lines refused because the ring was full
+    unsigned long txwrites;     // writev() calls, each sends every line queued at the time
+    unsigned long txbytes;      // bytes written
+    unsigned long txerrors;     // write errors, the queued bytes are discarded
+    unsigned long txqueued;     // bytes waiting in the ring
+    unsigned long txhighwater;  // most bytes ever waiting in the ring
+} serialstats_s;
+
 void serial_init(void);
+int serial_open(const char *);
 void serial_config(void);
-void serial_println(const char *, int);
+int serial_set_baud(long);
+void serial_discard(void);
+int serial_println(const char *, int);
+int serial_tx_flush(int);
 void serial_readln(char *, int);
+int serial_readln_timeout(char *, int, int);
+int serial_read_timeout(char *, int, int);
+serialstats_s serial_get_stats(void);
 void serial_close(void);
 
 #endif
@@ -0,0 +1,284 @@
+/** \file serloop.c
+ *  \brief Pseudo-terminal loopback harness for the serial and NMEA receive path
+ *
+ *  A pty pair stands in for the GPS UART: serial_open()/serial_config() drive the slave side
+ *  exactly as they would PORTNAME, while a generator thread writes the sentences of an NMEA
+ *  log into the master side at the byte rate of a given baud rate, optionally in bursts.
+ *  Every line returned by serial_readln_timeout() is matched to the time it was written, so
+ *  the report gives the end-to-end sentence latency and the CPU used per sentence by the
+ *  receiving thread, with no hardware attached.
+ *
+ *  Usage: serloop [-b baud] [-n sentences] [-B burst] [-g gap ms] [-p] [log]
+ *         -b  baud rate emulated by the generator, 10 bits per byte, 0 writes flat out
+ *         -n  sentences to send, the log is repeated as needed
+ *         -B  sentences per burst, sent back to back at the baud rate
+ *         -g  idle time between bursts [ms]
+ *         -p  also parse every line with the streaming NMEA parser
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include "serial.h"
+#include "nmea.h"
+
+#define LOOPMAXSENTENCES 4096   // sentences kept from the log
+#define LOOPLINESZ 256
+
+typedef struct loopgen
+{
+    int master;                 // pty master, the generator's end of the line
+    char **sentence;            // log sentences with "\r\n"
+    size_t *length;
+    size_t count;
+    long total;                 // sentences to send
+    long baud;
+    long burst;
+    long gapms;
+    double *sent;               // write time of every sentence [ns]
+} loopgen_s;
+
+/** \brief Nanoseconds on the monotonic clock
+ *
+ * \param void
+ * \return double nanoseconds
+ */
+static double LoopNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** \brief Sleep until a time on the monotonic clock
+ *
+ * \param nanoseconds
+ * \return void
+ */
+static void LoopSleepUntil(double due)
+{
+    struct timespec ts;
+
+    ts.tv_sec = (time_t)(due / 1e9);
+    ts.tv_nsec = (long)(due - ts.tv_sec * 1e9);
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) { }
+}
+
+/** \brief Read the '$' sentences of an NMEA log
+ *
+ * \param loopgen_s structure, file name
+ * \return int 1 on success, 0 if the log is missing or has no sentences
+ */
+static int LoopLoad(loopgen_s *gen, const char *fname)
+{
+    char line[LOOPLINESZ];
+    FILE *fp;
+    size_t n;
+
+    fp = fopen(fname, "r");
+    if(fp == NULL) { return 0; }
+
+    gen->sentence = (char **)calloc(LOOPMAXSENTENCES, sizeof(char *));
+    gen->length = (size_t *)calloc(LOOPMAXSENTENCES, sizeof(size_t));
+    while(gen->count < LOOPMAXSENTENCES && fgets(line, sizeof(line) - 2, fp) != NULL)
+    {
+        if(line[0] != '$') { continue; }
+        n = strcspn(line, "\r\n");
+        memcpy(line + n, "\r\n", 3);
+        gen->sentence[gen->count] = strdup(line);
+        gen->length[gen->count] = n + 2;
+        gen->count++;
+    }
+    fclose(fp);
+
+    return gen->count > 0;
+}
+
+/** \brief Generator thread, writes sentences into the pty master at the emulated baud rate
+ *
+ * Each sentence is written whole when its first byte would reach the wire, so the latency
+ * measured excludes the sentence's own transmission time.
+ *
+ * \param loopgen_s structure
+ * \return NULL
+ */
+static void *LoopGenerate(void *arg)
+{
+    loopgen_s *gen = (loopgen_s *)arg;
+    double due;
+    size_t len, done;
+    ssize_t n;
+    long i;
+
+    due = LoopNow();
+    for(i = 0; i < gen->total; i++)
+    {
+        if(i > 0 && gen->burst > 0 && i % gen->burst == 0) { due += gen->gapms * 1e6; }
+        if(gen->baud > 0) { LoopSleepUntil(due); }
+
+        len = gen->length[i % gen->count];
+        gen->sent[i] = LoopNow();
+        for(done = 0; done < len; done += n)
+        {
+            n = write(gen->master, gen->sentence[i % gen->count] + done, len - done);
+            if(n < 0) { return NULL; }
+        }
+
+        // The next sentence starts once this one would be off the wire
+        if(gen->baud > 0) { due += len * 10.0 / gen->baud * 1e9; }
+    }
+
+    return NULL;
+}
+
+/** \brief Sort helper for latencies
+ *
+ * \param two doubles
+ * \return int order
+ */
+static int LoopCompare(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/** \brief Count the records of the streaming parser
+ *
+ * \param message type, record, counter
+ * \return void
+ */
+static void LoopRecord(uint8_t type, const void *record, void *ctx)
+{
+    (void)type;
+    (void)record;
+    (*(unsigned long *)ctx)++;
+}
+
+/** \brief Print the usage
+ *
+ * \param program name
+ * \return int 1
+ */
+static int LoopUsage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-b baud] [-n sentences] [-B burst] [-g gap ms] [-p] [log]\n", name);
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    loopgen_s gen = {0};
+    pthread_t thread;
+    nmeastream_t stream;
+    serialstats_s stats;
+    struct rusage ru0, ru1;
+    const char *log = "gpslog01.txt";
+    char line[LOOPLINESZ];
+    double *latency, wall, cpu;
+    unsigned long records = 0;
+    long received = 0, i;
+    int parse = 0, timeouts = 0, opt, n;
+
+    gen.baud = 9600;
+    gen.total = 1000;
+    while((opt = getopt(argc, argv, "b:n:B:g:p")) != -1)
+    {
+        switch(opt)
+        {
+            case 'b': gen.baud = atol(optarg); break;
+            case 'n': gen.total = atol(optarg); break;
+            case 'B': gen.burst = atol(optarg); break;
+            case 'g': gen.gapms = atol(optarg); break;
+            case 'p': parse = 1; break;
+            default: return LoopUsage(argv[0]);
+        }
+    }
+    if(optind < argc) { log = argv[optind]; }
+    if(gen.total < 1) { return LoopUsage(argv[0]); }
+    if(!LoopLoad(&gen, log))
+    {
+        fprintf(stderr, "No sentences in %s\n", log);
+        return 1;
+    }
+
+    gen.master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(gen.master < 0 || grantpt(gen.master) != 0 || unlockpt(gen.master) != 0)
+    {
+        perror("posix_openpt");
+        return 1;
+    }
+    if(serial_open(ptsname(gen.master)) == -1)
+    {
+        perror(ptsname(gen.master));
+        return 1;
+    }
+    serial_config();
+
+    gen.sent = (double *)calloc(gen.total, sizeof(double));
+    latency = (double *)calloc(gen.total, sizeof(double));
+    nmea_stream_init(&stream, LoopRecord, &records);
+
+    getrusage(RUSAGE_THREAD, &ru0);
+    wall = LoopNow();
+    pthread_create(&thread, NULL, LoopGenerate, &gen);
+
+    while(received < gen.total)
+    {
+        n = serial_readln_timeout(line, sizeof(line), SERIALTIMEOUT);
+        if(n < 0) { break; }
+        if(n == 0)
+        {
+            // The generator has gone quiet for longer than any burst gap
+            if(++timeouts * SERIALTIMEOUT > 2 * SERIALTIMEOUT + gen.gapms) { break; }
+            continue;
+        }
+        timeouts = 0;
+        latency[received] = LoopNow() - gen.sent[received];
+        received++;
+        if(parse)
+        {
+            nmea_stream_feed(&stream, line, n);
+            nmea_stream_feed(&stream, "\n", 1);
+        }
+    }
+
+    wall = LoopNow() - wall;
+    getrusage(RUSAGE_THREAD, &ru1);
+    pthread_join(thread, NULL);
+    stats = serial_get_stats();
+    serial_close();
+    close(gen.master);
+
+    cpu = (ru1.ru_utime.tv_sec - ru0.ru_utime.tv_sec + ru1.ru_stime.tv_sec - ru0.ru_stime.tv_sec) * 1e9 +
+          (ru1.ru_utime.tv_usec - ru0.ru_utime.tv_usec + ru1.ru_stime.tv_usec - ru0.ru_stime.tv_usec) * 1e3;
+
+    printf("%ld of %ld sentences in %.3f s at %ld baud", received, gen.total, wall / 1e9, gen.baud);
+    if(gen.burst > 0) { printf(", bursts of %ld every %ld ms", gen.burst, gen.gapms); }
+    printf("\n");
+    if(received == 0) { return 1; }
+
+    qsort(latency, received, sizeof(double), LoopCompare);
+    printf("latency  p50 %8.1f us  p90 %8.1f us  p99 %8.1f us  max %8.1f us\n",
+           latency[received / 2] / 1e3, latency[received * 9 / 10] / 1e3,
+           latency[received * 99 / 100] / 1e3, latency[received - 1] / 1e3);
+    printf("receiver %.2f us CPU per sentence (user+system)\n", cpu / received / 1e3);
+    printf("serial   %lu reads, %.2f sentences per read, %lu bytes, %lu overruns\n",
+           stats.reads, stats.reads ? (double)stats.lines / stats.reads : 0.0, stats.bytes, stats.overruns);
+    if(parse) { printf("parser   %lu records\n", records); }
+
+    for(i = 0; i < (long)gen.count; i++) { free(gen.sentence[i]); }
+    free(gen.sentence);
+    free(gen.length);
+    free(gen.sent);
+    free(latency);
+
+    return (received == gen.total) ? 0 : 1;
+}
@@ -118,6 +118,8 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////
 
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include "spa.h"
 
 #define PI         3.1415926535897932384626433832795028841971
@@ -132,6 +134,8 @@
 #define B_MAX_SUBCOUNT 5
 #define R_MAX_SUBCOUNT 40
 
+#define BATCH_CHUNK 64
+
 enum {TERM_A, TERM_B, TERM_C, TERM_COUNT};
 enum {TERM_X0, TERM_X1, TERM_X2, TERM_X3, TERM_X4, TERM_X_COUNT};
 enum {TERM_PSI_A, TERM_PSI_B, TERM_EPS_C, TERM_EPS_D, TERM_PE_COUNT};
@@ -384,6 +388,16 @@ const double R_TERMS[R_COUNT][R_MAX_SUBCOUNT][TERM_COUNT]=
 ///  Periodic Terms for the nutation in longitude and obliquity
 ////////////////////////////////////////////////////////////////
 
+// Nutation arguments x0 to x4 as third_order_polynomial(a, b, c, d, jce), in degrees
+const double X_TERMS[TERM_X_COUNT][4]=
+{
+    { 1.0/189474.0, -0.0019142, 445267.11148,  297.85036},
+    {-1.0/300000.0, -0.0001603,  35999.05034,  357.52772},
+    { 1.0/56250.0,   0.0086972, 477198.867398, 134.96298},
+    { 1.0/327270.0, -0.0036825, 483202.017538,  93.27191},
+    { 1.0/450000.0,  0.0020708,  -1934.136261, 125.04452}
+};
+
 const int Y_TERMS[Y_COUNT][TERM_Y_COUNT]=
 {
     {0,0,0,0,1},
@@ -681,13 +695,331 @@ double earth_periodic_term_summation(const double terms[][TERM_COUNT], int count
     return sum;
 }
 
-double earth_values(double term_sum[], int count, double jme)
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Vectorized earth periodic term summation
+//
+// The L, B and R tables are copied into aligned structure-of-arrays form (one array each for
+// the A, B and C coefficients of every order), padded with zero terms to a multiple of the
+// vector width.  The summation kernel is selected once at load time: AVX2+FMA (4 terms per
+// instruction) or SSE2 (2 terms) on x86, otherwise the scalar loop.  The vector kernels use
+// a Cody-Waite reduction by pi/2 and the fdlibm sin/cos polynomials, which are accurate to
+// about one ulp over the whole range of arguments produced by the tables.
+///////////////////////////////////////////////////////////////////////////////////////////////
+#define TERM_VECTOR         4
+#define TERM_PADDED(count)  (((count) + TERM_VECTOR - 1) / TERM_VECTOR * TERM_VECTOR)
+
+#define L_SOA_SUBCOUNT TERM_PADDED(L_MAX_SUBCOUNT)
+#define B_SOA_SUBCOUNT TERM_PADDED(B_MAX_SUBCOUNT)
+#define R_SOA_SUBCOUNT TERM_PADDED(R_MAX_SUBCOUNT)
+
+static double L_SOA[L_COUNT][TERM_COUNT][L_SOA_SUBCOUNT] __attribute__((aligned(32)));
+static double B_SOA[B_COUNT][TERM_COUNT][B_SOA_SUBCOUNT] __attribute__((aligned(32)));
+static double R_SOA[R_COUNT][TERM_COUNT][R_SOA_SUBCOUNT] __attribute__((aligned(32)));
+
+typedef double (*term_kernel)(const double *a, const double *b, const double *c, int count,
+                              double jme);
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Batch versions of the periodic term summations.  The timestamps of a batch chunk are close
+// together, so each order of the L, B and R series and each nutation sum is expanded as a
+// Taylor series in the time from a reference timestamp in the middle of the chunk.  Every
+// term is evaluated once per chunk, with the sines and cosines taken 4 (AVX2) or 2 (SSE2)
+// at a time, and each timestamp then costs one short polynomial per series instead of a
+// cosine per term.  A chunk in which some term could turn by more than TERM_ROTATE_MAX is
+// evaluated in full at every timestamp instead.
+///////////////////////////////////////////////////////////////////////////////////////////////
+#define TERM_ROTATE_MAX   0.05  // largest turn of a term from the chunk reference [radians]
+#define TERM_TAYLOR_ORDER 8     // degree of the expansions, the first omitted term is below
+                                // 1e-17 of the term amplitude at TERM_ROTATE_MAX
+
+typedef void (*sincos_kernel)(const double *x, int count, double *sinx, double *cosx);
+
+static double term_c_max;                   // largest |C| of the L, B and R terms
+static int    y_term_max[TERM_Y_COUNT];     // largest |Y| of each nutation argument
+static double PE_SOA[TERM_PE_COUNT][TERM_PADDED(Y_COUNT)];  // PE_TERMS by column, zero padded
+
+double periodic_term_kernel_scalar(const double *a, const double *b, const double *c, int count,
+                                   double jme)
 {
     int i;
     double sum=0;
 
     for (i = 0; i < count; i++)
-        sum += term_sum[i]*pow(jme, i);
+        sum += a[i]*cos(b[i]+c[i]*jme);
+
+    return sum;
+}
+
+void periodic_sincos_kernel_scalar(const double *x, int count, double *sinx, double *cosx)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        sinx[i] = sin(x[i]);
+        cosx[i] = cos(x[i]);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+#define PIO2_INV  6.36619772367581382433e-01  // 2/pi
+#define PIO2_1    1.57079632673412561417e+00  // first 33 bits of pi/2
+#define PIO2_2    6.07710050630396597660e-11  // second 33 bits of pi/2
+#define PIO2_3    2.02226624871116645580e-21  // third 33 bits of pi/2
+#define ROUND_MAGIC 6755399441055744.0        // 1.5*2^52, rounds to integer and keeps it in the low bits
+
+#define SIN_S1 -1.66666666666666324348e-01
+#define SIN_S2  8.33333333332248946124e-03
+#define SIN_S3 -1.98412698298579493134e-04
+#define SIN_S4  2.75573137070700676789e-06
+#define SIN_S5 -2.50507602534068634195e-08
+#define SIN_S6  1.58969099521155010221e-10
+
+#define COS_C1  4.16666666666666019037e-02
+#define COS_C2 -1.38888888888741095749e-03
+#define COS_C3  2.48015872894767294178e-05
+#define COS_C4 -2.75573143513906633035e-07
+#define COS_C5  2.08757232129817482790e-09
+#define COS_C6 -1.13596475577881948265e-11
+
+// sin(x) and cos(x) of four arguments: quadrant from a rounding by pi/2, three part Cody-Waite
+// reduction, then the fdlibm kernels on [-pi/4, pi/4]
+static inline __attribute__((target("avx2,fma")))
+void periodic_sincos_avx2(__m256d x, __m256d *sinx, __m256d *cosx)
+{
+    const __m256d magic = _mm256_set1_pd(ROUND_MAGIC);
+    const __m256i one   = _mm256_set1_epi64x(1);
+    const __m256i two   = _mm256_set1_epi64x(2);
+    __m256d t, n, r, z, s, co, swap;
+    __m256i q;
+
+    t = _mm256_fmadd_pd(x, _mm256_set1_pd(PIO2_INV), magic);
+    n = _mm256_sub_pd(t, magic);
+    q = _mm256_castpd_si256(t);
+
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(PIO2_1), x);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(PIO2_2), r);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(PIO2_3), r);
+    z = _mm256_mul_pd(r, r);
+
+    s = _mm256_fmadd_pd(z, _mm256_set1_pd(SIN_S6), _mm256_set1_pd(SIN_S5));
+    s = _mm256_fmadd_pd(z, s, _mm256_set1_pd(SIN_S4));
+    s = _mm256_fmadd_pd(z, s, _mm256_set1_pd(SIN_S3));
+    s = _mm256_fmadd_pd(z, s, _mm256_set1_pd(SIN_S2));
+    s = _mm256_fmadd_pd(z, s, _mm256_set1_pd(SIN_S1));
+    s = _mm256_fmadd_pd(_mm256_mul_pd(z, r), s, r);
+
+    co = _mm256_fmadd_pd(z, _mm256_set1_pd(COS_C6), _mm256_set1_pd(COS_C5));
+    co = _mm256_fmadd_pd(z, co, _mm256_set1_pd(COS_C4));
+    co = _mm256_fmadd_pd(z, co, _mm256_set1_pd(COS_C3));
+    co = _mm256_fmadd_pd(z, co, _mm256_set1_pd(COS_C2));
+    co = _mm256_fmadd_pd(z, co, _mm256_set1_pd(COS_C1));
+    co = _mm256_fmadd_pd(_mm256_mul_pd(z, z), co,
+                         _mm256_fnmadd_pd(z, _mm256_set1_pd(0.5), _mm256_set1_pd(1.0)));
+
+    // sin(x) = sin(r), cos(r), -sin(r), -cos(r) and
+    // cos(x) = cos(r), -sin(r), -cos(r), sin(r) for quadrants 0 to 3
+    swap  = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(q, one), one));
+    *sinx = _mm256_xor_pd(_mm256_blendv_pd(s, co, swap),
+                          _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(q, two), 62)));
+    *cosx = _mm256_xor_pd(_mm256_blendv_pd(co, s, swap),
+                          _mm256_castsi256_pd(_mm256_slli_epi64(
+                              _mm256_and_si256(_mm256_add_epi64(q, one), two), 62)));
+}
+
+__attribute__((target("avx2,fma")))
+double periodic_term_kernel_avx2(const double *a, const double *b, const double *c, int count,
+                                 double jme)
+{
+    const __m256d vjme = _mm256_set1_pd(jme);
+    __m256d sum = _mm256_setzero_pd();
+    __m256d x, s, res;
+    double lane[TERM_VECTOR];
+    int i;
+
+    for (i = 0; i < count; i += TERM_VECTOR)
+    {
+        x = _mm256_fmadd_pd(_mm256_load_pd(c+i), vjme, _mm256_load_pd(b+i));
+        periodic_sincos_avx2(x, &s, &res);
+        sum = _mm256_fmadd_pd(_mm256_load_pd(a+i), res, sum);
+    }
+
+    _mm256_storeu_pd(lane, sum);
+
+    return (lane[0] + lane[1]) + (lane[2] + lane[3]);
+}
+
+// Same as periodic_sincos_avx2() for two arguments
+static inline __attribute__((target("sse2")))
+void periodic_sincos_sse2(__m128d x, __m128d *sinx, __m128d *cosx)
+{
+    const __m128d magic = _mm_set1_pd(ROUND_MAGIC);
+    const __m128i one   = _mm_set1_epi64x(1);
+    const __m128i two   = _mm_set1_epi64x(2);
+    __m128d t, n, r, z, s, co, swap;
+    __m128i q;
+
+    t = _mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(PIO2_INV)), magic);
+    n = _mm_sub_pd(t, magic);
+    q = _mm_castpd_si128(t);
+
+    r = _mm_sub_pd(x, _mm_mul_pd(n, _mm_set1_pd(PIO2_1)));
+    r = _mm_sub_pd(r, _mm_mul_pd(n, _mm_set1_pd(PIO2_2)));
+    r = _mm_sub_pd(r, _mm_mul_pd(n, _mm_set1_pd(PIO2_3)));
+    z = _mm_mul_pd(r, r);
+
+    s = _mm_add_pd(_mm_mul_pd(z, _mm_set1_pd(SIN_S6)), _mm_set1_pd(SIN_S5));
+    s = _mm_add_pd(_mm_mul_pd(z, s), _mm_set1_pd(SIN_S4));
+    s = _mm_add_pd(_mm_mul_pd(z, s), _mm_set1_pd(SIN_S3));
+    s = _mm_add_pd(_mm_mul_pd(z, s), _mm_set1_pd(SIN_S2));
+    s = _mm_add_pd(_mm_mul_pd(z, s), _mm_set1_pd(SIN_S1));
+    s = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(z, r), s), r);
+
+    co = _mm_add_pd(_mm_mul_pd(z, _mm_set1_pd(COS_C6)), _mm_set1_pd(COS_C5));
+    co = _mm_add_pd(_mm_mul_pd(z, co), _mm_set1_pd(COS_C4));
+    co = _mm_add_pd(_mm_mul_pd(z, co), _mm_set1_pd(COS_C3));
+    co = _mm_add_pd(_mm_mul_pd(z, co), _mm_set1_pd(COS_C2));
+    co = _mm_add_pd(_mm_mul_pd(z, co), _mm_set1_pd(COS_C1));
+    co = _mm_add_pd(_mm_mul_pd(_mm_mul_pd(z, z), co),
+                    _mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(z, _mm_set1_pd(0.5))));
+
+    // SSE2 has no 64-bit compare, so spread bit 0 of each quadrant over its whole lane
+    swap  = _mm_castsi128_pd(_mm_shuffle_epi32(_mm_srai_epi32(_mm_slli_epi32(q, 31), 31),
+                                               _MM_SHUFFLE(2,2,0,0)));
+    *sinx = _mm_or_pd(_mm_and_pd(swap, co), _mm_andnot_pd(swap, s));
+    *sinx = _mm_xor_pd(*sinx, _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(q, two), 62)));
+    *cosx = _mm_or_pd(_mm_and_pd(swap, s), _mm_andnot_pd(swap, co));
+    *cosx = _mm_xor_pd(*cosx, _mm_castsi128_pd(_mm_slli_epi64(
+                                  _mm_and_si128(_mm_add_epi64(q, one), two), 62)));
+}
+
+__attribute__((target("sse2")))
+double periodic_term_kernel_sse2(const double *a, const double *b, const double *c, int count,
+                                 double jme)
+{
+    const __m128d vjme = _mm_set1_pd(jme);
+    __m128d sum = _mm_setzero_pd();
+    __m128d x, s, res;
+    double lane[2];
+    int i;
+
+    for (i = 0; i < count; i += 2)
+    {
+        x = _mm_add_pd(_mm_mul_pd(_mm_load_pd(c+i), vjme), _mm_load_pd(b+i));
+        periodic_sincos_sse2(x, &s, &res);
+        sum = _mm_add_pd(_mm_mul_pd(_mm_load_pd(a+i), res), sum);
+    }
+
+    _mm_storeu_pd(lane, sum);
+
+    return lane[0] + lane[1];
+}
+
+__attribute__((target("avx2,fma")))
+void periodic_sincos_kernel_avx2(const double *x, int count, double *sinx, double *cosx)
+{
+    __m256d s, co;
+    int i;
+
+    for (i = 0; i < count; i += TERM_VECTOR)
+    {
+        periodic_sincos_avx2(_mm256_loadu_pd(x+i), &s, &co);
+        _mm256_storeu_pd(sinx+i, s);
+        _mm256_storeu_pd(cosx+i, co);
+    }
+}
+
+__attribute__((target("sse2")))
+void periodic_sincos_kernel_sse2(const double *x, int count, double *sinx, double *cosx)
+{
+    __m128d s, co;
+    int i;
+
+    for (i = 0; i < count; i += 2)
+    {
+        periodic_sincos_sse2(_mm_loadu_pd(x+i), &s, &co);
+        _mm_storeu_pd(sinx+i, s);
+        _mm_storeu_pd(cosx+i, co);
+    }
+}
+#endif
+
+static term_kernel periodic_term_kernel = periodic_term_kernel_scalar;
+static sincos_kernel periodic_sincos = periodic_sincos_kernel_scalar;
+static int periodic_term_kernel_id = SPA_KERNEL_SCALAR;
+
+int spa_select_term_kernel(int kernel)
+{
+    periodic_term_kernel    = periodic_term_kernel_scalar;
+    periodic_sincos         = periodic_sincos_kernel_scalar;
+    periodic_term_kernel_id = SPA_KERNEL_SCALAR;
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if ((kernel >= SPA_KERNEL_AVX2) && __builtin_cpu_supports("avx2") &&
+                                       __builtin_cpu_supports("fma")) {
+        periodic_term_kernel    = periodic_term_kernel_avx2;
+        periodic_sincos         = periodic_sincos_kernel_avx2;
+        periodic_term_kernel_id = SPA_KERNEL_AVX2;
+    }
+    else if ((kernel >= SPA_KERNEL_SSE2) && __builtin_cpu_supports("sse2")) {
+        periodic_term_kernel    = periodic_term_kernel_sse2;
+        periodic_sincos         = periodic_sincos_kernel_sse2;
+        periodic_term_kernel_id = SPA_KERNEL_SSE2;
+    }
+#endif
+
+    return periodic_term_kernel_id;
+}
+
+void transpose_periodic_terms(const double terms[][TERM_COUNT], int count, double *soa, int stride)
+{
+    int i, j;
+
+    for (j = 0; j < TERM_COUNT; j++)
+        for (i = 0; i < stride; i++)
+            soa[j*stride + i] = (i < count) ? terms[i][j] : 0.0;
+
+    for (i = 0; i < count; i++)
+        if (fabs(terms[i][TERM_C]) > term_c_max) term_c_max = fabs(terms[i][TERM_C]);
+}
+
+__attribute__((constructor))
+void earth_periodic_terms_init(void)
+{
+    int i, j;
+
+    for (i = 0; i < L_COUNT; i++)
+        transpose_periodic_terms(L_TERMS[i], l_subcount[i], L_SOA[i][0], L_SOA_SUBCOUNT);
+    for (i = 0; i < B_COUNT; i++)
+        transpose_periodic_terms(B_TERMS[i], b_subcount[i], B_SOA[i][0], B_SOA_SUBCOUNT);
+    for (i = 0; i < R_COUNT; i++)
+        transpose_periodic_terms(R_TERMS[i], r_subcount[i], R_SOA[i][0], R_SOA_SUBCOUNT);
+
+    for (i = 0; i < Y_COUNT; i++) {
+        for (j = 0; j < TERM_Y_COUNT; j++)
+            if (abs(Y_TERMS[i][j]) > y_term_max[j]) y_term_max[j] = abs(Y_TERMS[i][j]);
+        for (j = 0; j < TERM_PE_COUNT; j++)
+            PE_SOA[j][i] = PE_TERMS[i][j];
+    }
+
+    spa_select_term_kernel(SPA_KERNEL_AVX2);
+}
+
+double earth_periodic_term_summation_vector(const double *soa, int stride, int count, double jme)
+{
+    return periodic_term_kernel(soa, soa + stride, soa + 2*stride, TERM_PADDED(count), jme);
+}
+
+double earth_values(double term_sum[], int count, double jme)
+{
+    int i;
+    double sum=term_sum[count-1];
+
+    for (i = count-2; i >= 0; i--)
+        sum = sum*jme + term_sum[i];
 
     sum /= 1.0e8;
 
@@ -700,7 +1032,7 @@ double earth_heliocentric_longitude(double jme)
     int i;
 
     for (i = 0; i < L_COUNT; i++)
-        sum[i] = earth_periodic_term_summation(L_TERMS[i], l_subcount[i], jme);
+        sum[i] = earth_periodic_term_summation_vector(L_SOA[i][0], L_SOA_SUBCOUNT, l_subcount[i], jme);
 
     return limit_degrees(rad2deg(earth_values(sum, L_COUNT, jme)));
 
@@ -712,7 +1044,7 @@ double earth_heliocentric_latitude(double jme)
     int i;
 
     for (i = 0; i < B_COUNT; i++)
-        sum[i] = earth_periodic_term_summation(B_TERMS[i], b_subcount[i], jme);
+        sum[i] = earth_periodic_term_summation_vector(B_SOA[i][0], B_SOA_SUBCOUNT, b_subcount[i], jme);
 
     return rad2deg(earth_values(sum, B_COUNT, jme));
 
@@ -724,7 +1056,7 @@ double earth_radius_vector(double jme)
     int i;
 
     for (i = 0; i < R_COUNT; i++)
-        sum[i] = earth_periodic_term_summation(R_TERMS[i], r_subcount[i], jme);
+        sum[i] = earth_periodic_term_summation_vector(R_SOA[i][0], R_SOA_SUBCOUNT, r_subcount[i], jme);
 
     return earth_values(sum, R_COUNT, jme);
 
@@ -746,27 +1078,38 @@ double geocentric_latitude(double b)
 
 double mean_elongation_moon_sun(double jce)
 {
-    return third_order_polynomial(1.0/189474.0, -0.0019142, 445267.11148, 297.85036, jce);
+    return third_order_polynomial(X_TERMS[TERM_X0][0], X_TERMS[TERM_X0][1], X_TERMS[TERM_X0][2],
+                                  X_TERMS[TERM_X0][3], jce);
 }
 
 double mean_anomaly_sun(double jce)
 {
-    return third_order_polynomial(-1.0/300000.0, -0.0001603, 35999.05034, 357.52772, jce);
+    return third_order_polynomial(X_TERMS[TERM_X1][0], X_TERMS[TERM_X1][1], X_TERMS[TERM_X1][2],
+                                  X_TERMS[TERM_X1][3], jce);
 }
 
 double mean_anomaly_moon(double jce)
 {
-    return third_order_polynomial(1.0/56250.0, 0.0086972, 477198.867398, 134.96298, jce);
+    return third_order_polynomial(X_TERMS[TERM_X2][0], X_TERMS[TERM_X2][1], X_TERMS[TERM_X2][2],
+                                  X_TERMS[TERM_X2][3], jce);
 }
 
 double argument_latitude_moon(double jce)
 {
-    return third_order_polynomial(1.0/327270.0, -0.0036825, 483202.017538, 93.27191, jce);
+    return third_order_polynomial(X_TERMS[TERM_X3][0], X_TERMS[TERM_X3][1], X_TERMS[TERM_X3][2],
+                                  X_TERMS[TERM_X3][3], jce);
 }
 
 double ascending_longitude_moon(double jce)
 {
-    return third_order_polynomial(1.0/450000.0, 0.0020708, -1934.136261, 125.04452, jce);
+    return third_order_polynomial(X_TERMS[TERM_X4][0], X_TERMS[TERM_X4][1], X_TERMS[TERM_X4][2],
+                                  X_TERMS[TERM_X4][3], jce);
+}
+
+// Rate of change of nutation argument i (TERM_X0 to TERM_X4) [degrees per julian century]
+double nutation_argument_rate(int i, double jce)
+{
+    return (3.0*X_TERMS[i][0]*jce + 2.0*X_TERMS[i][1])*jce + X_TERMS[i][2];
 }
 
 double xy_term_summation(int i, double x[TERM_X_COUNT])
@@ -1010,44 +1353,121 @@ double sun_rise_and_set(double *m_rts,   double *h_rts,   double *delta_prime, d
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////
-// Calculate required SPA parameters to get the right ascension (alpha) and declination (delta)
-// Note: JD must be already calculated and in structure
+// Calculate the location-independent (geocentric) SPA parameters for a julian day and delta_t
 ////////////////////////////////////////////////////////////////////////////////////////////////
-void calculate_geocentric_sun_right_ascension_and_declination(spa_data *spa)
+void spa_calculate_geocentric(double jd, double delta_t, spa_geocentric *geo)
 {
     double x[TERM_X_COUNT];
 
-    spa->jc = julian_century(spa->jd);
+    geo->jd      = jd;
+    geo->delta_t = delta_t;
+
+    geo->jc = julian_century(geo->jd);
+
+    geo->jde = julian_ephemeris_day(geo->jd, geo->delta_t);
+    geo->jce = julian_ephemeris_century(geo->jde);
+    geo->jme = julian_ephemeris_millennium(geo->jce);
+
+    geo->l = earth_heliocentric_longitude(geo->jme);
+    geo->b = earth_heliocentric_latitude(geo->jme);
+    geo->r = earth_radius_vector(geo->jme);
+
+    geo->theta = geocentric_longitude(geo->l);
+    geo->beta  = geocentric_latitude(geo->b);
+
+    x[TERM_X0] = geo->x0 = mean_elongation_moon_sun(geo->jce);
+    x[TERM_X1] = geo->x1 = mean_anomaly_sun(geo->jce);
+    x[TERM_X2] = geo->x2 = mean_anomaly_moon(geo->jce);
+    x[TERM_X3] = geo->x3 = argument_latitude_moon(geo->jce);
+    x[TERM_X4] = geo->x4 = ascending_longitude_moon(geo->jce);
+
+    nutation_longitude_and_obliquity(geo->jce, x, &(geo->del_psi), &(geo->del_epsilon));
+
+    geo->epsilon0 = ecliptic_mean_obliquity(geo->jme);
+    geo->epsilon  = ecliptic_true_obliquity(geo->del_epsilon, geo->epsilon0);
 
-    spa->jde = julian_ephemeris_day(spa->jd, spa->delta_t);
-    spa->jce = julian_ephemeris_century(spa->jde);
-    spa->jme = julian_ephemeris_millennium(spa->jce);
+    geo->del_tau   = aberration_correction(geo->r);
+    geo->lamda     = apparent_sun_longitude(geo->theta, geo->del_psi, geo->del_tau);
+    geo->nu0       = greenwich_mean_sidereal_time (geo->jd, geo->jc);
+    geo->nu        = greenwich_sidereal_time (geo->nu0, geo->del_psi, geo->epsilon);
 
-    spa->l = earth_heliocentric_longitude(spa->jme);
-    spa->b = earth_heliocentric_latitude(spa->jme);
-    spa->r = earth_radius_vector(spa->jme);
+    geo->alpha = geocentric_right_ascension(geo->lamda, geo->epsilon, geo->beta);
+    geo->delta = geocentric_declination(geo->beta, geo->epsilon, geo->lamda);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// Copy the geocentric parameters into the intermediate output values of the SPA structure
+////////////////////////////////////////////////////////////////////////////////////////////////
+void copy_geocentric_values(spa_data *spa, const spa_geocentric *geo)
+{
+    spa->jd  = geo->jd;
+    spa->jc  = geo->jc;
+    spa->jde = geo->jde;
+    spa->jce = geo->jce;
+    spa->jme = geo->jme;
+
+    spa->l = geo->l;
+    spa->b = geo->b;
+    spa->r = geo->r;
+
+    spa->theta = geo->theta;
+    spa->beta  = geo->beta;
+
+    spa->x0 = geo->x0;
+    spa->x1 = geo->x1;
+    spa->x2 = geo->x2;
+    spa->x3 = geo->x3;
+    spa->x4 = geo->x4;
+
+    spa->del_psi     = geo->del_psi;
+    spa->del_epsilon = geo->del_epsilon;
+    spa->epsilon0    = geo->epsilon0;
+    spa->epsilon     = geo->epsilon;
+
+    spa->del_tau = geo->del_tau;
+    spa->lamda   = geo->lamda;
+    spa->nu0     = geo->nu0;
+    spa->nu      = geo->nu;
+
+    spa->alpha = geo->alpha;
+    spa->delta = geo->delta;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////
+// Calculate required SPA parameters to get the right ascension (alpha) and declination (delta)
+// Note: JD must be already calculated and in structure
+////////////////////////////////////////////////////////////////////////////////////////////////
+void calculate_geocentric_sun_right_ascension_and_declination(spa_data *spa)
+{
+    spa_geocentric geo;
 
-    spa->theta = geocentric_longitude(spa->l);
-    spa->beta  = geocentric_latitude(spa->b);
+    spa_calculate_geocentric(spa->jd, spa->delta_t, &geo);
+    copy_geocentric_values(spa, &geo);
+}
 
-    x[TERM_X0] = spa->x0 = mean_elongation_moon_sun(spa->jce);
-    x[TERM_X1] = spa->x1 = mean_anomaly_sun(spa->jce);
-    x[TERM_X2] = spa->x2 = mean_anomaly_moon(spa->jce);
-    x[TERM_X3] = spa->x3 = argument_latitude_moon(spa->jce);
-    x[TERM_X4] = spa->x4 = ascending_longitude_moon(spa->jce);
+////////////////////////////////////////////////////////////////////////////////////////////////
+// Look up the geocentric parameters for a julian day and delta_t, calculating them on a miss
+////////////////////////////////////////////////////////////////////////////////////////////////
+const spa_geocentric *spa_geocentric_lookup(spa_geocentric_cache *cache, double jd, double delta_t)
+{
+    spa_geocentric *geo;
+    unsigned long long key;
+    int slot;
 
-    nutation_longitude_and_obliquity(spa->jce, x, &(spa->del_psi), &(spa->del_epsilon));
+    memcpy(&key, &jd, sizeof(key));
+    slot = (int)((key ^ (key >> 17) ^ (key >> 31)) % SPA_GEO_CACHE_SIZE);
+    geo  = &(cache->entry[slot]);
 
-    spa->epsilon0 = ecliptic_mean_obliquity(spa->jme);
-    spa->epsilon  = ecliptic_true_obliquity(spa->del_epsilon, spa->epsilon0);
+    if (cache->valid[slot] && (geo->jd == jd) && (geo->delta_t == delta_t)) {
+        cache->hits++;
+        return geo;
+    }
 
-    spa->del_tau   = aberration_correction(spa->r);
-    spa->lamda     = apparent_sun_longitude(spa->theta, spa->del_psi, spa->del_tau);
-    spa->nu0       = greenwich_mean_sidereal_time (spa->jd, spa->jc);
-    spa->nu        = greenwich_sidereal_time (spa->nu0, spa->del_psi, spa->epsilon);
+    spa_calculate_geocentric(jd, delta_t, geo);
+    cache->valid[slot] = 1;
+    cache->misses++;
 
-    spa->alpha = geocentric_right_ascension(spa->lamda, spa->epsilon, spa->beta);
-    spa->delta = geocentric_declination(spa->beta, spa->epsilon, spa->lamda);
+    return geo;
 }
 
 ////////////////////////////////////////////////////////////////////////
@@ -1123,6 +1543,39 @@ void calculate_eot_and_sun_rise_transit_set(spa_data *spa)
 
 }
 
+////////////////////////////////////////////////////////////////////////
+// Calculate the observer (topocentric) values from the geocentric values
+// Note: Geocentric values must be already calculated and in structure
+////////////////////////////////////////////////////////////////////////
+void calculate_observer_values(spa_data *spa)
+{
+    spa->h  = observer_hour_angle(spa->nu, spa->longitude, spa->alpha);
+    spa->xi = sun_equatorial_horizontal_parallax(spa->r);
+
+    right_ascension_parallax_and_topocentric_dec(spa->latitude, spa->elevation, spa->xi,
+                            spa->h, spa->delta, &(spa->del_alpha), &(spa->delta_prime));
+
+    spa->alpha_prime = topocentric_right_ascension(spa->alpha, spa->del_alpha);
+    spa->h_prime     = topocentric_local_hour_angle(spa->h, spa->del_alpha);
+
+    spa->e0      = topocentric_elevation_angle(spa->latitude, spa->delta_prime, spa->h_prime);
+    spa->del_e   = atmospheric_refraction_correction(spa->pressure, spa->temperature,
+                                                     spa->atmos_refract, spa->e0);
+    spa->e       = topocentric_elevation_angle_corrected(spa->e0, spa->del_e);
+
+    spa->zenith        = topocentric_zenith_angle(spa->e);
+    spa->azimuth_astro = topocentric_azimuth_angle_astro(spa->h_prime, spa->latitude,
+                                                                       spa->delta_prime);
+    spa->azimuth       = topocentric_azimuth_angle(spa->azimuth_astro);
+
+    if ((spa->function == SPA_ZA_INC) || (spa->function == SPA_ALL))
+        spa->incidence  = surface_incidence_angle(spa->zenith, spa->azimuth_astro,
+                                                  spa->azm_rotation, spa->slope);
+
+    if ((spa->function == SPA_ZA_RTS) || (spa->function == SPA_ALL))
+        calculate_eot_and_sun_rise_transit_set(spa);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////
 // Calculate all SPA parameters and put into structure
 // Note: All inputs values (listed in header file) must already be in structure
@@ -1139,34 +1592,601 @@ int spa_calculate(spa_data *spa)
 			                  spa->minute, spa->second, spa->delta_ut1, spa->timezone);
 
         calculate_geocentric_sun_right_ascension_and_declination(spa);
+        calculate_observer_values(spa);
+    }
+
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Calculate all SPA parameters using precalculated geocentric values (from
+// spa_calculate_geocentric() or spa_geocentric_lookup()) for the observer in the structure
+///////////////////////////////////////////////////////////////////////////////////////////
+int spa_calculate_observer(spa_data *spa, const spa_geocentric *geo)
+{
+    int result;
+
+    result = validate_inputs(spa);
+
+    if (result == 0)
+    {
+        copy_geocentric_values(spa, geo);
+        calculate_observer_values(spa);
+    }
+
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Calculate the observer site terms used by calculate_site_observer_values()
+///////////////////////////////////////////////////////////////////////////////////////////
+int spa_site_init(spa_site *site, spa_data *spa)
+{
+    int result;
+    double lat_rad, u;
+
+    result = validate_inputs(spa);
+
+    if (result == 0)
+    {
+        lat_rad = deg2rad(spa->latitude);
+        u       = atan(0.99664719 * tan(lat_rad));
+
+        site->longitude    = spa->longitude;
+        site->azm_rotation = spa->azm_rotation;
+        site->min_e0       = -1*(SUN_RADIUS + spa->atmos_refract);
+        site->refract      = (spa->pressure / 1010.0) * (283.0 / (273.0 + spa->temperature)) *
+                              1.02 / 60.0;
+
+        site->sin_lat   = sin(lat_rad);
+        site->cos_lat   = cos(lat_rad);
+        site->y_par     = 0.99664719 * sin(u) + spa->elevation*site->sin_lat/6378140.0;
+        site->x_par     =              cos(u) + spa->elevation*site->cos_lat/6378140.0;
+        site->sin_slope = sin(deg2rad(spa->slope));
+        site->cos_slope = cos(deg2rad(spa->slope));
+        site->sin_rot   = sin(deg2rad(spa->azm_rotation));
+        site->cos_rot   = cos(deg2rad(spa->azm_rotation));
+    }
 
-        spa->h  = observer_hour_angle(spa->nu, spa->longitude, spa->alpha);
-        spa->xi = sun_equatorial_horizontal_parallax(spa->r);
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Same values as calculate_observer_values(), with the site terms taken from the site.  The
+// sines and cosines of the topocentric angles follow from those of the geocentric angles,
+// so each angle needs one inverse function.  The parallax denominator is always positive,
+// which lets atan() stand in for atan2().
+///////////////////////////////////////////////////////////////////////////////////////////
+void calculate_site_observer_values(spa_data *spa, const spa_site *site)
+{
+    double sin_xi, sin_h, cos_h, sin_delta, cos_delta, h_rad, delta_rad, e_rad;
+    double num, denom, hyp, sin_da, cos_da, dec_num, sin_dp, cos_dp, sin_hp, cos_hp;
+    double az_y, az_x, cos_az;
+
+    spa->h  = observer_hour_angle(spa->nu, site->longitude, spa->alpha);
+    spa->xi = sun_equatorial_horizontal_parallax(spa->r);
+
+    sin_xi    = sin(deg2rad(spa->xi));
+    h_rad     = deg2rad(spa->h);
+    delta_rad = deg2rad(spa->delta);
+    sin_h     = sin(h_rad);
+    cos_h     = cos(h_rad);
+    sin_delta = sin(delta_rad);
+    cos_delta = cos(delta_rad);
+
+    num    = - site->x_par*sin_xi*sin_h;
+    denom  = cos_delta - site->x_par*sin_xi*cos_h;
+    hyp    = sqrt(num*num + denom*denom);
+    sin_da = num / hyp;
+    cos_da = denom / hyp;
+
+    dec_num = (sin_delta - site->y_par*sin_xi)*cos_da;
+    hyp     = sqrt(dec_num*dec_num + denom*denom);
+    sin_dp  = dec_num / hyp;
+    cos_dp  = denom / hyp;
+
+    spa->del_alpha   = rad2deg(atan(num / denom));
+    spa->delta_prime = rad2deg(atan(dec_num / denom));
+    spa->alpha_prime = topocentric_right_ascension(spa->alpha, spa->del_alpha);
+    spa->h_prime     = topocentric_local_hour_angle(spa->h, spa->del_alpha);
+
+    sin_hp = sin_h*cos_da - cos_h*sin_da;
+    cos_hp = cos_h*cos_da + sin_h*sin_da;
+
+    spa->e0    = rad2deg(asin(site->sin_lat*sin_dp + site->cos_lat*cos_dp*cos_hp));
+    spa->del_e = 0;
+    if (spa->e0 >= site->min_e0)
+        spa->del_e = site->refract / tan(deg2rad(spa->e0 + 10.3/(spa->e0 + 5.11)));
+    spa->e     = topocentric_elevation_angle_corrected(spa->e0, spa->del_e);
+
+    // Azimuth arguments of topocentric_azimuth_angle_astro() multiplied by cos(delta_prime)
+    az_y = sin_hp*cos_dp;
+    az_x = cos_hp*site->sin_lat*cos_dp - sin_dp*site->cos_lat;
+
+    spa->zenith        = topocentric_zenith_angle(spa->e);
+    spa->azimuth_astro = limit_degrees(rad2deg(atan2(az_y, az_x)));
+    spa->azimuth       = topocentric_azimuth_angle(spa->azimuth_astro);
 
-        right_ascension_parallax_and_topocentric_dec(spa->latitude, spa->elevation, spa->xi,
-                                spa->h, spa->delta, &(spa->del_alpha), &(spa->delta_prime));
+    if ((spa->function == SPA_ZA_INC) || (spa->function == SPA_ALL))
+    {
+        hyp    = sqrt(az_x*az_x + az_y*az_y);
+        cos_az = (hyp > 0) ? (az_x*site->cos_rot + az_y*site->sin_rot) / hyp : site->cos_rot;
+        e_rad  = deg2rad(spa->e);
+        spa->incidence = rad2deg(acos(sin(e_rad)*site->cos_slope +
+                                      site->sin_slope*cos(e_rad)*cos_az));
+    }
+
+    if ((spa->function == SPA_ZA_RTS) || (spa->function == SPA_ALL))
+        calculate_eot_and_sun_rise_transit_set(spa);
+}
 
-        spa->alpha_prime = topocentric_right_ascension(spa->alpha, spa->del_alpha);
-        spa->h_prime     = topocentric_local_hour_angle(spa->h, spa->del_alpha);
+///////////////////////////////////////////////////////////////////////////////////////////
+// Calculate all SPA parameters from precalculated geocentric values and a prepared site
+///////////////////////////////////////////////////////////////////////////////////////////
+void spa_calculate_site(spa_data *spa, const spa_site *site, const spa_geocentric *geo)
+{
+    copy_geocentric_values(spa, geo);
+    calculate_site_observer_values(spa, site);
+}
 
-        spa->e0      = topocentric_elevation_angle(spa->latitude, spa->delta_prime, spa->h_prime);
-        spa->del_e   = atmospheric_refraction_correction(spa->pressure, spa->temperature,
-                                                         spa->atmos_refract, spa->e0);
-        spa->e       = topocentric_elevation_angle_corrected(spa->e0, spa->del_e);
+///////////////////////////////////////////////////////////////////////////////////////////
+// Calculate all SPA parameters, taking the geocentric values from the cache
+///////////////////////////////////////////////////////////////////////////////////////////
+int spa_calculate_cached(spa_data *spa, spa_geocentric_cache *cache)
+{
+    int result;
 
-        spa->zenith        = topocentric_zenith_angle(spa->e);
-        spa->azimuth_astro = topocentric_azimuth_angle_astro(spa->h_prime, spa->latitude,
-                                                                           spa->delta_prime);
-        spa->azimuth       = topocentric_azimuth_angle(spa->azimuth_astro);
+    result = validate_inputs(spa);
 
-        if ((spa->function == SPA_ZA_INC) || (spa->function == SPA_ALL))
-            spa->incidence  = surface_incidence_angle(spa->zenith, spa->azimuth_astro,
-                                                      spa->azm_rotation, spa->slope);
+    if (result == 0)
+    {
+        spa->jd = julian_day (spa->year,   spa->month,  spa->day,       spa->hour,
+			                  spa->minute, spa->second, spa->delta_ut1, spa->timezone);
 
-        if ((spa->function == SPA_ZA_RTS) || (spa->function == SPA_ALL))
-            calculate_eot_and_sun_rise_transit_set(spa);
+        copy_geocentric_values(spa, spa_geocentric_lookup(cache, spa->jd, spa->delta_t));
+        calculate_observer_values(spa);
     }
 
     return result;
 }
-///////////////////////////////////////////////////////////////////////////////////////////
\ No newline at end of file
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Prepare a stepper with the requested refresh window [days]
+///////////////////////////////////////////////////////////////////////////////////////////
+void spa_stepper_init(spa_stepper *step, double window)
+{
+    memset(step, 0, sizeof(spa_stepper));
+    step->window = (window > 0) ? window : SPA_STEP_WINDOW;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Move the stepper window so that it contains jd.  Stepping into the following window
+// reuses the old end point, so a steady forward walk costs one full evaluation per window.
+///////////////////////////////////////////////////////////////////////////////////////////
+void stepper_refresh(spa_stepper *step, double jd, double delta_t)
+{
+    double jd0 = step->start.jd;
+
+    if (step->valid && (step->start.delta_t == delta_t) &&
+        (jd >= jd0) && (jd <= jd0 + step->window))
+        return;
+
+    if (step->valid && (step->end.delta_t == delta_t) &&
+        (jd >= step->end.jd) && (jd <= step->end.jd + step->window))
+    {
+        step->start = step->end;
+    }
+    else
+    {
+        spa_calculate_geocentric(jd, delta_t, &(step->start));
+        step->refreshes++;
+    }
+
+    spa_calculate_geocentric(step->start.jd + step->window, delta_t, &(step->end));
+    step->refreshes++;
+    step->valid = 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Geocentric values at jd from the stepper window.  The heliocentric longitude, latitude,
+// radius vector and nutation are interpolated, everything else is calculated directly.
+///////////////////////////////////////////////////////////////////////////////////////////
+void stepper_geocentric(const spa_stepper *step, double jd, spa_geocentric *geo)
+{
+    const spa_geocentric *g0 = &(step->start);
+    const spa_geocentric *g1 = &(step->end);
+    double f = (jd - g0->jd) / step->window;
+
+    geo->jd      = jd;
+    geo->delta_t = g0->delta_t;
+
+    geo->jc  = julian_century(geo->jd);
+    geo->jde = julian_ephemeris_day(geo->jd, geo->delta_t);
+    geo->jce = julian_ephemeris_century(geo->jde);
+    geo->jme = julian_ephemeris_millennium(geo->jce);
+
+    geo->l = limit_degrees(g0->l + f*limit_degrees180pm(g1->l - g0->l));
+    geo->b = g0->b + f*(g1->b - g0->b);
+    geo->r = g0->r + f*(g1->r - g0->r);
+
+    geo->theta = geocentric_longitude(geo->l);
+    geo->beta  = geocentric_latitude(geo->b);
+
+    geo->x0 = mean_elongation_moon_sun(geo->jce);
+    geo->x1 = mean_anomaly_sun(geo->jce);
+    geo->x2 = mean_anomaly_moon(geo->jce);
+    geo->x3 = argument_latitude_moon(geo->jce);
+    geo->x4 = ascending_longitude_moon(geo->jce);
+
+    geo->del_psi     = g0->del_psi     + f*(g1->del_psi     - g0->del_psi);
+    geo->del_epsilon = g0->del_epsilon + f*(g1->del_epsilon - g0->del_epsilon);
+
+    geo->epsilon0 = ecliptic_mean_obliquity(geo->jme);
+    geo->epsilon  = ecliptic_true_obliquity(geo->del_epsilon, geo->epsilon0);
+
+    geo->del_tau   = aberration_correction(geo->r);
+    geo->lamda     = apparent_sun_longitude(geo->theta, geo->del_psi, geo->del_tau);
+    geo->nu0       = greenwich_mean_sidereal_time (geo->jd, geo->jc);
+    geo->nu        = greenwich_sidereal_time (geo->nu0, geo->del_psi, geo->epsilon);
+
+    geo->alpha = geocentric_right_ascension(geo->lamda, geo->epsilon, geo->beta);
+    geo->delta = geocentric_declination(geo->beta, geo->epsilon, geo->lamda);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Calculate all SPA parameters, interpolating the slowly varying terms from the stepper
+///////////////////////////////////////////////////////////////////////////////////////////
+int spa_calculate_step(spa_data *spa, spa_stepper *step)
+{
+    spa_geocentric geo;
+    int result;
+
+    result = validate_inputs(spa);
+
+    if (result == 0)
+    {
+        spa->jd = julian_day (spa->year,   spa->month,  spa->day,       spa->hour,
+			                  spa->minute, spa->second, spa->delta_ut1, spa->timezone);
+
+        stepper_refresh(step, spa->jd, spa->delta_t);
+        stepper_geocentric(step, spa->jd, &geo);
+        step->steps++;
+
+        copy_geocentric_values(spa, &geo);
+        calculate_observer_values(spa);
+    }
+
+    return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Taylor coefficients about d = 0 of sum(a[i]*cos(phi[i] + w[i]*d)), from the sines and
+// cosines of phi[i].  With shift 3 they are the coefficients of sum(a[i]*sin(phi[i] + w[i]*d)).
+///////////////////////////////////////////////////////////////////////////////////////////
+void periodic_term_taylor(const double *a, const double *w, const double *sin_phi,
+                          const double *cos_phi, int count, int shift, double *coef)
+{
+    double p[L_SOA_SUBCOUNT], sum[TERM_VECTOR], factorial=1;
+    const double *derivative;
+    int i, k, m, q;
+
+    for (i = 0; i < count; i++) p[i] = a[i];
+
+    for (m = 0; m <= TERM_TAYLOR_ORDER; m++) {
+        // cos, -sin, -cos, sin are the derivatives of cos
+        q          = m + shift;
+        derivative = (q & 1) ? sin_phi : cos_phi;
+
+        for (k = 0; k < TERM_VECTOR; k++) sum[k] = 0;
+        for (i = 0; i < count; i += TERM_VECTOR)
+            for (k = 0; k < TERM_VECTOR; k++) {
+                sum[k] += p[i+k]*derivative[i+k];
+                p[i+k] *= w[i+k];
+            }
+
+        coef[m] = ((sum[0] + sum[1]) + (sum[2] + sum[3])) / factorial;
+        if ((q+1) & 2) coef[m] = -coef[m];
+        factorial *= m+1;
+    }
+}
+
+// Evaluate the Taylor polynomial at d[j] for every timestamp.  TERM_VECTOR timestamps are
+// evaluated together so that their polynomials overlap instead of waiting on each other.
+// n must be a multiple of TERM_VECTOR.
+void taylor_polynomial_batch(const double *coef, const double *d, int n, double *sum)
+{
+    double c[TERM_TAYLOR_ORDER+1], value[TERM_VECTOR];
+    int j, k, m;
+
+    for (m = 0; m <= TERM_TAYLOR_ORDER; m++) c[m] = coef[m];
+
+    for (j = 0; j < n; j += TERM_VECTOR) {
+        for (k = 0; k < TERM_VECTOR; k++) value[k] = c[TERM_TAYLOR_ORDER];
+
+        for (m = TERM_TAYLOR_ORDER-1; m >= 0; m--)
+            for (k = 0; k < TERM_VECTOR; k++)
+                value[k] = value[k]*d[j+k] + c[m];
+
+        for (k = 0; k < TERM_VECTOR; k++) sum[j+k] = value[k];
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Return the reference timestamp of a batch chunk, or -1 when some L, B, R or nutation term
+// could turn by more than TERM_ROTATE_MAX between it and another timestamp of the chunk
+///////////////////////////////////////////////////////////////////////////////////////////
+int periodic_term_batch_reference(const double *jme, const double *jce, int n)
+{
+    int ref = n/2, j, k;
+    double d_jme=0, d_jce=0, rate=0;
+
+    for (j = 0; j < n; j++) {
+        if (fabs(jme[j] - jme[ref]) > d_jme) d_jme = fabs(jme[j] - jme[ref]);
+        if (fabs(jce[j] - jce[ref]) > d_jce) d_jce = fabs(jce[j] - jce[ref]);
+    }
+
+    for (k = 0; k < TERM_Y_COUNT; k++)
+        rate += y_term_max[k]*fabs(nutation_argument_rate(k, jce[ref]));
+
+    if ((d_jme*term_c_max > TERM_ROTATE_MAX) || (deg2rad(rate)*d_jce > TERM_ROTATE_MAX))
+        return -1;
+
+    return ref;
+}
+
+void earth_periodic_term_summation_batch(const double *soa, int stride, int count,
+                                         const double *jme, int ref, int n, double *sum)
+{
+    double phi[L_SOA_SUBCOUNT], sin_phi[L_SOA_SUBCOUNT], cos_phi[L_SOA_SUBCOUNT];
+    double coef[TERM_TAYLOR_ORDER+1], d[BATCH_CHUNK];
+    int i, j;
+
+    if (ref < 0) {
+        for (j = 0; j < n; j++)
+            sum[j] = earth_periodic_term_summation_vector(soa, stride, count, jme[j]);
+    }
+    else {
+        for (i = 0; i < TERM_PADDED(count); i++)
+            phi[i] = soa[stride + i] + soa[2*stride + i]*jme[ref];
+
+        periodic_sincos(phi, TERM_PADDED(count), sin_phi, cos_phi);
+        periodic_term_taylor(soa, soa + 2*stride, sin_phi, cos_phi, TERM_PADDED(count), 0, coef);
+
+        for (j = 0; j < TERM_PADDED(n); j++) d[j] = (j < n) ? jme[j] - jme[ref] : 0;
+        taylor_polynomial_batch(coef, d, TERM_PADDED(n), sum);
+    }
+}
+
+// The arguments are expanded to first order about the reference, the second order term is
+// below 1e-14 degrees over a chunk
+void nutation_longitude_and_obliquity_batch(const double *jce, double x[][BATCH_CHUNK], int ref,
+                                            int n, double *del_psi, double *del_epsilon)
+{
+    double arg[TERM_PADDED(Y_COUNT)], sin_arg[TERM_PADDED(Y_COUNT)], cos_arg[TERM_PADDED(Y_COUNT)];
+    double rate[TERM_PADDED(Y_COUNT)], coef[TERM_PE_COUNT][TERM_TAYLOR_ORDER+1];
+    double xj[TERM_X_COUNT], x_rate[TERM_X_COUNT], d[BATCH_CHUNK], sum[TERM_PE_COUNT][BATCH_CHUNK];
+    int i, j, k;
+
+    if (ref < 0) {
+        for (j = 0; j < n; j++) {
+            for (k = 0; k < TERM_X_COUNT; k++) xj[k] = x[k][j];
+            nutation_longitude_and_obliquity(jce[j], xj, &del_psi[j], &del_epsilon[j]);
+        }
+    }
+    else {
+        for (k = 0; k < TERM_X_COUNT; k++) {
+            xj[k]     = x[k][ref];
+            x_rate[k] = nutation_argument_rate(k, jce[ref]);
+        }
+
+        for (i = 0; i < TERM_PADDED(Y_COUNT); i++) {
+            arg[i]  = (i < Y_COUNT) ? deg2rad(xy_term_summation(i, xj))     : 0;
+            rate[i] = (i < Y_COUNT) ? deg2rad(xy_term_summation(i, x_rate)) : 0;
+        }
+
+        periodic_sincos(arg, TERM_PADDED(Y_COUNT), sin_arg, cos_arg);
+        periodic_term_taylor(PE_SOA[TERM_PSI_A], rate, sin_arg, cos_arg, TERM_PADDED(Y_COUNT), 3,
+                             coef[TERM_PSI_A]);
+        periodic_term_taylor(PE_SOA[TERM_PSI_B], rate, sin_arg, cos_arg, TERM_PADDED(Y_COUNT), 3,
+                             coef[TERM_PSI_B]);
+        periodic_term_taylor(PE_SOA[TERM_EPS_C], rate, sin_arg, cos_arg, TERM_PADDED(Y_COUNT), 0,
+                             coef[TERM_EPS_C]);
+        periodic_term_taylor(PE_SOA[TERM_EPS_D], rate, sin_arg, cos_arg, TERM_PADDED(Y_COUNT), 0,
+                             coef[TERM_EPS_D]);
+
+        for (j = 0; j < TERM_PADDED(n); j++) d[j] = (j < n) ? jce[j] - jce[ref] : 0;
+        for (k = 0; k < TERM_PE_COUNT; k++)
+            taylor_polynomial_batch(coef[k], d, TERM_PADDED(n), sum[k]);
+
+        for (j = 0; j < n; j++) {
+            del_psi[j]     = (sum[TERM_PSI_A][j] + jce[j]*sum[TERM_PSI_B][j]) / 36000000.0;
+            del_epsilon[j] = (sum[TERM_EPS_C][j] + jce[j]*sum[TERM_EPS_D][j]) / 36000000.0;
+        }
+    }
+}
+
+// Angles of the observer stage of spa_calculate_batch(), one row of a chunk each
+enum {OBS_LAMDA, OBS_EPSILON, OBS_BETA, OBS_XI, OBS_H, OBS_DELTA, OBS_DEL_ALPHA,
+      OBS_H_PRIME, OBS_DELTA_PRIME, OBS_ZENITH, OBS_AZIMUTH, OBS_COUNT};
+
+// Sines and cosines of rows first to last of the first n timestamps of a chunk
+void batch_sincos(double angle[][BATCH_CHUNK], int first, int last, int n,
+                  double sin_angle[][BATCH_CHUNK], double cos_angle[][BATCH_CHUNK])
+{
+    int i, j;
+
+    for (i = first; i <= last; i++) {
+        for (j = n; j < TERM_PADDED(n); j++) angle[i][j] = 0;
+        periodic_sincos(angle[i], TERM_PADDED(n), sin_angle[i], cos_angle[i]);
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////
+// Calculate zenith, azimuth (and incidence) for one site at every timestamp in the batch
+// Note: site holds the location/atmosphere inputs, its date and time fields are ignored
+///////////////////////////////////////////////////////////////////////////////////////////
+int spa_calculate_batch(const spa_data *site, spa_batch *batch)
+{
+    spa_data spa = *site;
+    double jd[BATCH_CHUNK], jc[BATCH_CHUNK], jce[BATCH_CHUNK], jme[BATCH_CHUNK];
+    double l_sum[L_COUNT][BATCH_CHUNK], b_sum[B_COUNT][BATCH_CHUNK];
+    double r_sum[R_COUNT][BATCH_CHUNK], x[TERM_X_COUNT][BATCH_CHUNK];
+    double del_psi[BATCH_CHUNK], del_epsilon[BATCH_CHUNK];
+    double term_sum[L_COUNT];
+    double angle[OBS_COUNT][BATCH_CHUNK], sin_angle[OBS_COUNT][BATCH_CHUNK];
+    double cos_angle[OBS_COUNT][BATCH_CHUNK], hour[BATCH_CHUNK], denom[BATCH_CHUNK];
+    double l, b, r, epsilon, lamda, nu, alpha, delta, del_alpha, delta_prime, h_prime;
+    double e0, e, azimuth_astro;
+    double lat_rad, sin_lat, cos_lat, u, y_par, x_par, sin_slope, cos_slope;
+    int start, n, ref, i, j, k, result;
+    int incidence = ((spa.function == SPA_ZA_INC) || (spa.function == SPA_ALL)) &&
+                     (batch->incidence != 0);
+
+    // Site terms of right_ascension_parallax_and_topocentric_dec(), the elevation, azimuth
+    // and incidence functions, which are otherwise re-evaluated at every timestamp
+    lat_rad   = deg2rad(spa.latitude);
+    sin_lat   = sin(lat_rad);
+    cos_lat   = cos(lat_rad);
+    u         = atan(0.99664719 * tan(lat_rad));
+    y_par     = 0.99664719 * sin(u) + spa.elevation*sin_lat/6378140.0;
+    x_par     =              cos(u) + spa.elevation*cos_lat/6378140.0;
+    sin_slope = sin(deg2rad(spa.slope));
+    cos_slope = cos(deg2rad(spa.slope));
+
+    for (start = 0; start < batch->count; start += n)
+    {
+        n = batch->count - start;
+        if (n > BATCH_CHUNK) n = BATCH_CHUNK;
+
+        for (j = 0; j < n; j++) {
+            k = start + j;
+            spa.year   = batch->year[k];
+            spa.month  = batch->month[k];
+            spa.day    = batch->day[k];
+            spa.hour   = batch->hour[k];
+            spa.minute = batch->minute[k];
+            spa.second = batch->second[k];
+
+            result = validate_inputs(&spa);
+            if (result != 0) return result;
+
+            jd[j]  = julian_day (spa.year,   spa.month,  spa.day,       spa.hour,
+                                 spa.minute, spa.second, spa.delta_ut1, spa.timezone);
+            jc[j]  = julian_century(jd[j]);
+            jce[j] = julian_ephemeris_century(julian_ephemeris_day(jd[j], spa.delta_t));
+            jme[j] = julian_ephemeris_millennium(jce[j]);
+
+            x[TERM_X0][j] = mean_elongation_moon_sun(jce[j]);
+            x[TERM_X1][j] = mean_anomaly_sun(jce[j]);
+            x[TERM_X2][j] = mean_anomaly_moon(jce[j]);
+            x[TERM_X3][j] = argument_latitude_moon(jce[j]);
+            x[TERM_X4][j] = ascending_longitude_moon(jce[j]);
+        }
+
+        ref = periodic_term_batch_reference(jme, jce, n);
+
+        for (i = 0; i < L_COUNT; i++)
+            earth_periodic_term_summation_batch(L_SOA[i][0], L_SOA_SUBCOUNT, l_subcount[i],
+                                                jme, ref, n, l_sum[i]);
+        for (i = 0; i < B_COUNT; i++)
+            earth_periodic_term_summation_batch(B_SOA[i][0], B_SOA_SUBCOUNT, b_subcount[i],
+                                                jme, ref, n, b_sum[i]);
+        for (i = 0; i < R_COUNT; i++)
+            earth_periodic_term_summation_batch(R_SOA[i][0], R_SOA_SUBCOUNT, r_subcount[i],
+                                                jme, ref, n, r_sum[i]);
+
+        nutation_longitude_and_obliquity_batch(jce, x, ref, n, del_psi, del_epsilon);
+
+        // The observer functions below are evaluated in stages, with the sines and cosines
+        // of each stage taken across the chunk and each tangent taken as their ratio.
+        for (j = 0; j < n; j++)
+        {
+            for (i = 0; i < L_COUNT; i++) term_sum[i] = l_sum[i][j];
+            l = limit_degrees(rad2deg(earth_values(term_sum, L_COUNT, jme[j])));
+            for (i = 0; i < B_COUNT; i++) term_sum[i] = b_sum[i][j];
+            b = rad2deg(earth_values(term_sum, B_COUNT, jme[j]));
+            for (i = 0; i < R_COUNT; i++) term_sum[i] = r_sum[i][j];
+            r = earth_values(term_sum, R_COUNT, jme[j]);
+
+            epsilon = ecliptic_true_obliquity(del_epsilon[j], ecliptic_mean_obliquity(jme[j]));
+            lamda   = apparent_sun_longitude(geocentric_longitude(l), del_psi[j],
+                                             aberration_correction(r));
+            nu      = greenwich_sidereal_time(greenwich_mean_sidereal_time(jd[j], jc[j]),
+                                              del_psi[j], epsilon);
+
+            angle[OBS_LAMDA][j]   = deg2rad(lamda);
+            angle[OBS_EPSILON][j] = deg2rad(epsilon);
+            angle[OBS_BETA][j]    = deg2rad(geocentric_latitude(b));
+            angle[OBS_XI][j]      = deg2rad(sun_equatorial_horizontal_parallax(r));
+            hour[j]               = nu;
+        }
+        batch_sincos(angle, OBS_LAMDA, OBS_XI, n, sin_angle, cos_angle);
+
+        for (j = 0; j < n; j++)
+        {
+            alpha = limit_degrees(rad2deg(atan2(sin_angle[OBS_LAMDA][j]*cos_angle[OBS_EPSILON][j] -
+                                      sin_angle[OBS_BETA][j]/cos_angle[OBS_BETA][j]*
+                                      sin_angle[OBS_EPSILON][j], cos_angle[OBS_LAMDA][j])));
+            delta = rad2deg(asin(sin_angle[OBS_BETA][j]*cos_angle[OBS_EPSILON][j] +
+                                 cos_angle[OBS_BETA][j]*sin_angle[OBS_EPSILON][j]*
+                                 sin_angle[OBS_LAMDA][j]));
+
+            hour[j]             = observer_hour_angle(hour[j], spa.longitude, alpha);
+            angle[OBS_H][j]     = deg2rad(hour[j]);
+            angle[OBS_DELTA][j] = deg2rad(delta);
+        }
+        batch_sincos(angle, OBS_H, OBS_DELTA, n, sin_angle, cos_angle);
+
+        for (j = 0; j < n; j++)
+        {
+            denom[j] = cos_angle[OBS_DELTA][j] - x_par*sin_angle[OBS_XI][j]*cos_angle[OBS_H][j];
+            angle[OBS_DEL_ALPHA][j] = atan2(- x_par*sin_angle[OBS_XI][j]*sin_angle[OBS_H][j],
+                                            denom[j]);
+        }
+        batch_sincos(angle, OBS_DEL_ALPHA, OBS_DEL_ALPHA, n, sin_angle, cos_angle);
+
+        for (j = 0; j < n; j++)
+        {
+            delta_prime = rad2deg(atan2((sin_angle[OBS_DELTA][j] - y_par*sin_angle[OBS_XI][j])*
+                                        cos_angle[OBS_DEL_ALPHA][j], denom[j]));
+            del_alpha   = rad2deg(angle[OBS_DEL_ALPHA][j]);
+            h_prime     = topocentric_local_hour_angle(hour[j], del_alpha);
+
+            angle[OBS_H_PRIME][j]     = deg2rad(h_prime);
+            angle[OBS_DELTA_PRIME][j] = deg2rad(delta_prime);
+        }
+        batch_sincos(angle, OBS_H_PRIME, OBS_DELTA_PRIME, n, sin_angle, cos_angle);
+
+        for (j = 0; j < n; j++)
+        {
+            k = start + j;
+
+            e0 = rad2deg(asin(sin_lat*sin_angle[OBS_DELTA_PRIME][j] +
+                              cos_lat*cos_angle[OBS_DELTA_PRIME][j]*cos_angle[OBS_H_PRIME][j]));
+            e  = topocentric_elevation_angle_corrected(e0,
+                     atmospheric_refraction_correction(spa.pressure, spa.temperature,
+                                                       spa.atmos_refract, e0));
+
+            azimuth_astro = limit_degrees(rad2deg(atan2(sin_angle[OBS_H_PRIME][j],
+                                cos_angle[OBS_H_PRIME][j]*sin_lat - sin_angle[OBS_DELTA_PRIME][j]/
+                                cos_angle[OBS_DELTA_PRIME][j]*cos_lat)));
+
+            batch->zenith[k]  = topocentric_zenith_angle(e);
+            batch->azimuth[k] = topocentric_azimuth_angle(azimuth_astro);
+
+            angle[OBS_ZENITH][j]  = deg2rad(batch->zenith[k]);
+            angle[OBS_AZIMUTH][j] = deg2rad(azimuth_astro - spa.azm_rotation);
+        }
+
+        if (incidence) {
+            batch_sincos(angle, OBS_ZENITH, OBS_AZIMUTH, n, sin_angle, cos_angle);
+
+            for (j = 0; j < n; j++)
+                batch->incidence[start + j] = rad2deg(acos(cos_angle[OBS_ZENITH][j]*cos_slope +
+                                                   sin_slope*sin_angle[OBS_ZENITH][j]*
+                                                   cos_angle[OBS_AZIMUTH][j]));
+        }
+    }
+
+    return 0;
+}
@@ -60,6 +60,13 @@ enum {
     SPA_ALL,          //calculate all SPA output values
 };
 
+//enumeration for the earth periodic term summation kernels (see spa_select_term_kernel)
+enum {
+    SPA_KERNEL_SCALAR,  //portable scalar loop
+    SPA_KERNEL_SSE2,    //x86 SSE2, 2 terms per instruction
+    SPA_KERNEL_AVX2,    //x86 AVX2 and FMA, 4 terms per instruction
+};
+
 typedef struct
 {
     //----------------------INPUT VALUES------------------------
@@ -178,6 +185,119 @@ typedef struct
 
 } spa_data;
 
+//Location-independent (geocentric) SPA values.  These depend only on the julian day and
+//delta_t, so one evaluation can be shared by every observer at the same instant.
+typedef struct
+{
+    double jd;          //Julian day
+    double delta_t;     //Difference between earth rotation time and terrestrial time [seconds]
+
+    double jc;          //Julian century
+    double jde;         //Julian ephemeris day
+    double jce;         //Julian ephemeris century
+    double jme;         //Julian ephemeris millennium
+
+    double l;           //earth heliocentric longitude [degrees]
+    double b;           //earth heliocentric latitude [degrees]
+    double r;           //earth radius vector [Astronomical Units, AU]
+
+    double theta;       //geocentric longitude [degrees]
+    double beta;        //geocentric latitude [degrees]
+
+    double x0;          //mean elongation (moon-sun) [degrees]
+    double x1;          //mean anomaly (sun) [degrees]
+    double x2;          //mean anomaly (moon) [degrees]
+    double x3;          //argument latitude (moon) [degrees]
+    double x4;          //ascending longitude (moon) [degrees]
+
+    double del_psi;     //nutation longitude [degrees]
+    double del_epsilon; //nutation obliquity [degrees]
+    double epsilon0;    //ecliptic mean obliquity [arc seconds]
+    double epsilon;     //ecliptic true obliquity  [degrees]
+
+    double del_tau;     //aberration correction [degrees]
+    double lamda;       //apparent sun longitude [degrees]
+    double nu0;         //Greenwich mean sidereal time [degrees]
+    double nu;          //Greenwich sidereal time [degrees]
+
+    double alpha;       //geocentric sun right ascension [degrees]
+    double delta;       //geocentric sun declination [degrees]
+} spa_geocentric;
+
+//Small direct-mapped cache of geocentric values keyed by julian day and delta_t.
+//Zero-initialize before first use; each thread should own its own cache.
+#define SPA_GEO_CACHE_SIZE 16
+
+typedef struct
+{
+    spa_geocentric entry[SPA_GEO_CACHE_SIZE];
+    int valid[SPA_GEO_CACHE_SIZE];
+    unsigned long hits;
+    unsigned long misses;
+} spa_geocentric_cache;
+
+//Stepper context for consecutive calls a few seconds apart.  The heliocentric series and
+//nutation are evaluated at the ends of a refresh window and interpolated inside it, the
+//remaining (cheap) geocentric and observer values are calculated exactly on every call.
+//Initialize with spa_stepper_init(); each thread or tracker should own its own stepper.
+#define SPA_STEP_WINDOW 0.25   //default refresh window [days]
+
+typedef struct
+{
+    double window;          //refresh window [days]
+    int    valid;           //non-zero when the end points below are filled
+
+    spa_geocentric start;   //geocentric values at the start of the window
+    spa_geocentric end;     //geocentric values at the end of the window
+
+    unsigned long steps;      //calls answered
+    unsigned long refreshes;  //full geocentric evaluations
+} spa_stepper;
+
+//Observer site terms that only depend on the location, atmosphere and surface, so a
+//tracker at one site can skip them on every call.  Prepare with spa_site_init() and
+//prepare again whenever any of those inputs change.
+typedef struct
+{
+    double longitude;       //observer longitude [degrees]
+    double azm_rotation;    //surface azimuth rotation [degrees]
+    double min_e0;          //lowest elevation that gets the refraction correction [degrees]
+    double refract;         //pressure and temperature factor of the refraction correction
+
+    double sin_lat;         //sine of the observer latitude
+    double cos_lat;         //cosine of the observer latitude
+    double x_par;           //parallax term x (earth flattening and elevation)
+    double y_par;           //parallax term y (earth flattening and elevation)
+    double sin_slope;       //sine of the surface slope
+    double cos_slope;       //cosine of the surface slope
+    double sin_rot;         //sine of the surface azimuth rotation
+    double cos_rot;         //cosine of the surface azimuth rotation
+} spa_site;
+
+//Structure-of-arrays used by spa_calculate_batch() to evaluate one site at many timestamps.
+//The site inputs (location, atmosphere, surface and function) come from a spa_data
+//structure, while the date and time of each point come from the input arrays below.
+typedef struct
+{
+    int count;              // Number of timestamps in each array
+
+    //----------------------INPUT ARRAYS------------------------
+
+    const int    *year;     // 4-digit year
+    const int    *month;    // 2-digit month
+    const int    *day;      // 2-digit day
+    const int    *hour;     // Observer local hour
+    const int    *minute;   // Observer local minute
+    const double *second;   // Observer local second
+
+    //---------------------OUTPUT ARRAYS------------------------
+
+    double *zenith;         // topocentric zenith angle [degrees]
+    double *azimuth;        // topocentric azimuth angle (eastward from north) [degrees]
+    double *incidence;      // surface incidence angle [degrees]
+                            // (only filled for SPA_ZA_INC and SPA_ALL, may be 0 otherwise)
+} spa_batch;
+
 //-------------- Utility functions for other applications (such as NREL's SAMPA) --------------
 double deg2rad(double degrees);
 double rad2deg(double radians);
@@ -197,9 +317,65 @@ double topocentric_elevation_angle_corrected(double e0, double delta_e);
 double topocentric_zenith_angle(double e);
 double topocentric_azimuth_angle_astro(double h_prime, double latitude, double delta_prime);
 double topocentric_azimuth_angle(double azimuth_astro);
+double julian_day (int year, int month, int day, int hour, int minute, double second,
+                   double dut1, double tz);
+double julian_century(double jd);
+double julian_ephemeris_day(double jd, double delta_t);
+double julian_ephemeris_century(double jde);
+double julian_ephemeris_millennium(double jce);
+double greenwich_mean_sidereal_time (double jd, double jc);
+int    validate_inputs(spa_data *spa);
+double earth_heliocentric_longitude(double jme);
+double earth_heliocentric_latitude(double jme);
+double earth_radius_vector(double jme);
+void   nutation_longitude_and_obliquity(double jce, double x[5], double *del_psi,
+                                        double *del_epsilon);
+void   calculate_eot_and_sun_rise_transit_set(spa_data *spa);
 
 
 //Calculate SPA output values (in structure) based on input values passed in structure
 int spa_calculate(spa_data *spa);
 
+//Select the periodic term summation kernel, falling back to the best one the CPU supports.
+//The best available kernel is selected automatically when the program is loaded.
+//Returns the kernel actually selected.
+int spa_select_term_kernel(int kernel);
+
+//Calculate the geocentric values for a julian day and delta_t
+void spa_calculate_geocentric(double jd, double delta_t, spa_geocentric *geo);
+
+//Return the cached geocentric values for a julian day and delta_t, calculating them on a miss
+const spa_geocentric *spa_geocentric_lookup(spa_geocentric_cache *cache, double jd, double delta_t);
+
+//Calculate SPA output values for the observer in the structure from precalculated geocentric
+//values.  The instant is taken from geo->jd, the date fields are only used for rise/transit/set.
+int spa_calculate_observer(spa_data *spa, const spa_geocentric *geo);
+
+//Prepare the site terms from the location, atmosphere and surface inputs of the structure.
+//Returns the input validation error code of spa_calculate(), the site is only set on 0.
+int spa_site_init(spa_site *site, spa_data *spa);
+
+//Same as spa_calculate_observer(), but the site terms come from a prepared site and the
+//inputs are not validated again.  The observer inputs of the structure must be the ones the
+//site was prepared from; they are only used for rise/transit/set.
+void spa_calculate_site(spa_data *spa, const spa_site *site, const spa_geocentric *geo);
+
+//Same as spa_calculate(), but the geocentric values are taken from (and added to) the cache
+int spa_calculate_cached(spa_data *spa, spa_geocentric_cache *cache);
+
+//Prepare a stepper, window is the refresh window in days (0 selects SPA_STEP_WINDOW).
+//Shorter windows are more accurate, SPA_STEP_WINDOW stays within 1e-5 degrees of spa_calculate()
+void spa_stepper_init(spa_stepper *step, double window);
+
+//Same as spa_calculate(), but the slowly varying geocentric terms come from the stepper.
+//Calls may move forward or backward in time, the window is refreshed when jd leaves it.
+int spa_calculate_step(spa_data *spa, spa_stepper *step);
+
+//Calculate zenith, azimuth and incidence for one site at every timestamp in the batch.
+//Timestamps a few minutes apart share one series expansion per chunk of 64, and agree with
+//spa_calculate() to about 1e-10 degrees; chunks spread over hours or days are evaluated in
+//full.  Sun rise/transit/set values are not calculated.  Returns the first non-zero input
+//validation error code.
+int spa_calculate_batch(const spa_data *site, spa_batch *batch);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,712 @@
+/** \file spabench.c
+ *  \brief SPA micro-benchmark and accuracy regression check
+ *
+ *  Times the SPA stages, each function code and each fast path over randomized inputs and
+ *  reports nanoseconds per call as mean and percentiles.  Before timing, every path is checked
+ *  against a stored reference dataset of full double precision results, so an optimization
+ *  that changes the answers fails the run.
+ *
+ *  Usage: spabench [-n calls] [-g] [reffile]
+ *         -g writes a new reference dataset from spa_calculate() instead of checking it.
+*/
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "spa.h"
+#include "spacheb.h"
+#include "spaf.h"
+
+#define BENCHREFFILE  "spabench.ref"
+#define BENCHREFPTS   500           // points written with -g
+#define BENCHINPUTS   4096          // randomized inputs used for timing
+#define BENCHCALLS    20000         // default timed calls per item
+#define BENCHBATCH    1440          // points per batch call (one day of minutes)
+#define BENCHBATCHDAY 10            // every n-th reference point is also checked as a batch day
+#define BENCHSTEPSEC  10            // control tick used for the stepper [seconds]
+#define BENCHSTEPLEAD 3             // hours between the stepper window start and the point
+#define BENCHDELTAT   69.184
+#define BENCHPI       3.1415926535897932384626433832795028841971
+
+// Accuracy tolerances against the reference [degrees, hours for rise/transit/set]
+#define BENCHTOLEXACT 1.0e-8        // full series paths (kernels only change rounding)
+#define BENCHTOLBATCH 1.0e-9        // batch against spa_calculate() over whole days
+#define BENCHTOLRTS   1.0e-6
+#define BENCHTOLSTEP  2.0e-5        // stepper with the default window
+#define BENCHTOLCHEB  1.0e-6
+#define BENCHTOLFLOAT 2.0e-3
+
+typedef struct benchref
+{
+    spa_data in;                    ///< inputs with function SPA_ALL
+    double zenith, azimuth, incidence, eot, sunrise, suntransit, sunset;
+} benchref_s;
+
+typedef struct benchstats
+{
+    double maxang;                  ///< largest zenith, azimuth*sin(zenith) or incidence error
+    double maxrts;                  ///< largest eot or rise/transit/set error
+} benchstats_s;
+
+static benchref_s *refs;
+static int nrefs;
+static spa_data inputs[BENCHINPUTS];
+static double *samples;
+static int ncalls = BENCHCALLS;
+static chebephem_s eph;
+static volatile double sink;
+static unsigned long seed = 12345;
+
+/** \brief Small deterministic random number generator
+ *
+ * \param void
+ * \return double uniform in 0 to 1
+ */
+static double BenchRandom(void)
+{
+    seed = seed * 6364136223846793005UL + 1442695040888963407UL;
+    return (double)(seed >> 11) / 9007199254740992.0;
+}
+
+/** \brief Read the monotonic clock
+ *
+ * \param void
+ * \return double nanoseconds
+ */
+static double BenchNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** \brief Fill a spa_data structure with a random site and time between 2000 and 2100
+ *
+ * \param spa_data structure, function code
+ * \return void
+ */
+static void BenchRandomInput(spa_data *spa, int function)
+{
+    memset(spa, 0, sizeof(spa_data));
+    spa->year          = 2000 + (int)(BenchRandom() * 101);
+    spa->month         = 1 + (int)(BenchRandom() * 12);
+    spa->day           = 1 + (int)(BenchRandom() * 28);
+    spa->hour          = (int)(BenchRandom() * 24);
+    spa->minute        = (int)(BenchRandom() * 60);
+    spa->second        = (int)(BenchRandom() * 60);
+    spa->timezone      = (int)(BenchRandom() * 25) - 12;
+    spa->delta_t       = BENCHDELTAT;
+    spa->latitude      = -65.0 + BenchRandom() * 130.0;
+    spa->longitude     = -180.0 + BenchRandom() * 360.0;
+    spa->elevation     = BenchRandom() * 3000.0;
+    spa->pressure      = 900.0 + BenchRandom() * 130.0;
+    spa->temperature   = -20.0 + BenchRandom() * 55.0;
+    spa->slope         = BenchRandom() * 90.0;
+    spa->azm_rotation  = -180.0 + BenchRandom() * 360.0;
+    spa->atmos_refract = 0.5667;
+    spa->function      = function;
+}
+
+/** \brief Write a new reference dataset from spa_calculate()
+ *
+ * \param file name
+ * \return int 1 on success, 0 on failure
+ */
+static int BenchWriteReference(const char *fname)
+{
+    FILE *fp;
+    spa_data spa;
+    int i;
+
+    fp = fopen(fname, "w");
+    if(fp == NULL) { return 0; }
+
+    fprintf(fp, "# spabench reference: year month day hour minute second timezone delta_t latitude "
+                "longitude elevation pressure temperature slope azm_rotation atmos_refract | "
+                "zenith azimuth incidence eot sunrise suntransit sunset\n");
+    for(i = 0; i < BENCHREFPTS; i++)
+    {
+        BenchRandomInput(&spa, SPA_ALL);
+        spa_calculate(&spa);
+        fprintf(fp, "%d %d %d %d %d %.17g %.17g %.17g %.17g %.17g %.17g %.17g %.17g %.17g %.17g "
+                    "%.17g | "
+                    "%.12f %.12f %.12f %.10f %.10f %.10f %.10f\n",
+                spa.year, spa.month, spa.day, spa.hour, spa.minute, spa.second, spa.timezone,
+                spa.delta_t, spa.latitude, spa.longitude, spa.elevation, spa.pressure,
+                spa.temperature, spa.slope, spa.azm_rotation, spa.atmos_refract,
+                spa.zenith, spa.azimuth, spa.incidence, spa.eot, spa.sunrise, spa.suntransit,
+                spa.sunset);
+    }
+    fclose(fp);
+
+    return 1;
+}
+
+/** \brief Load the reference dataset
+ *
+ * \param file name
+ * \return int number of points, 0 on failure
+ */
+static int BenchReadReference(const char *fname)
+{
+    FILE *fp;
+    char line[512];
+    benchref_s *r;
+    int cap = 0;
+
+    fp = fopen(fname, "r");
+    if(fp == NULL) { return 0; }
+
+    while(fgets(line, sizeof(line), fp) != NULL)
+    {
+        if(line[0] == '#') { continue; }
+        if(nrefs == cap)
+        {
+            cap = cap ? cap * 2 : 256;
+            refs = (benchref_s *)realloc(refs, sizeof(benchref_s) * cap);
+            if(refs == NULL) { fclose(fp); return 0; }
+        }
+        r = &refs[nrefs];
+        memset(r, 0, sizeof(benchref_s));
+        if(sscanf(line, "%d %d %d %d %d %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf %lf | "
+                        "%lf %lf %lf %lf %lf %lf %lf",
+                  &r->in.year, &r->in.month, &r->in.day, &r->in.hour, &r->in.minute,
+                  &r->in.second, &r->in.timezone, &r->in.delta_t, &r->in.latitude,
+                  &r->in.longitude, &r->in.elevation, &r->in.pressure, &r->in.temperature,
+                  &r->in.slope, &r->in.azm_rotation, &r->in.atmos_refract,
+                  &r->zenith, &r->azimuth, &r->incidence, &r->eot, &r->sunrise,
+                  &r->suntransit, &r->sunset) == 23)
+        {
+            r->in.function = SPA_ALL;
+            nrefs++;
+        }
+    }
+    fclose(fp);
+
+    return nrefs;
+}
+
+/** \brief Record the angle errors of one result against its reference point
+ *
+ * \param statistics, reference point, calculated result
+ * \return void
+ */
+static void BenchCompare(benchstats_s *st, const benchref_s *r, const spa_data *spa, int rts)
+{
+    double err, daz;
+
+    err = fabs(spa->zenith - r->zenith);
+    if(err > st->maxang) { st->maxang = err; }
+    daz = fabs(spa->azimuth - r->azimuth);
+    if(daz > 180.0) { daz = 360.0 - daz; }
+    err = daz * sin(r->zenith * BENCHPI / 180.0);
+    if(err > st->maxang) { st->maxang = err; }
+    err = fabs(spa->incidence - r->incidence);
+    if(err > st->maxang) { st->maxang = err; }
+
+    if(rts)
+    {
+        if(fabs(spa->eot - r->eot) > st->maxrts) { st->maxrts = fabs(spa->eot - r->eot); }
+        if(fabs(spa->sunrise - r->sunrise) > st->maxrts) { st->maxrts = fabs(spa->sunrise - r->sunrise); }
+        if(fabs(spa->suntransit - r->suntransit) > st->maxrts) { st->maxrts = fabs(spa->suntransit - r->suntransit); }
+        if(fabs(spa->sunset - r->sunset) > st->maxrts) { st->maxrts = fabs(spa->sunset - r->sunset); }
+    }
+}
+
+/** \brief Print one accuracy line
+ *
+ * \param name, statistics, angle and rise/transit/set tolerances (rts < 0 when not checked)
+ * \return int 1 when within tolerance, 0 otherwise
+ */
+static int BenchReport(const char *name, const benchstats_s *st, double tolang, double tolrts)
+{
+    int pass = (st->maxang <= tolang) && (tolrts < 0.0 || st->maxrts <= tolrts);
+
+    printf("  %-28s %12.3e %10.1e", name, st->maxang, tolang);
+    if(tolrts >= 0.0) { printf(" %12.3e %10.1e", st->maxrts, tolrts); }
+    else              { printf(" %12s %10s", "-", "-"); }
+    printf("   %s\n", pass ? "ok" : "FAIL");
+
+    return pass;
+}
+
+/** \brief Point a batch at one day of minutes at the site and date of spa
+ *
+ * \param inputs, batch
+ * \return void
+ */
+static void BenchBatchDay(const spa_data *spa, spa_batch *batch)
+{
+    static int byear[BENCHBATCH], bmonth[BENCHBATCH], bday[BENCHBATCH];
+    static int bhour[BENCHBATCH], bminute[BENCHBATCH];
+    static double bsecond[BENCHBATCH], bzen[BENCHBATCH], bazm[BENCHBATCH];
+    static double binc[BENCHBATCH];
+    int j;
+
+    for(j = 0; j < BENCHBATCH; j++)
+    {
+        byear[j] = spa->year;  bmonth[j] = spa->month;  bday[j] = spa->day;
+        bhour[j] = j / 60 % 24;  bminute[j] = j % 60;  bsecond[j] = spa->second;
+    }
+    batch->count = BENCHBATCH;
+    batch->year = byear;  batch->month = bmonth;  batch->day = bday;
+    batch->hour = bhour;  batch->minute = bminute;  batch->second = bsecond;
+    batch->zenith = bzen;  batch->azimuth = bazm;  batch->incidence = binc;
+}
+
+/** \brief Check every calculation path against the reference dataset
+ *
+ * \param void
+ * \return int 1 when all paths are within tolerance, 0 otherwise
+ */
+static int BenchAccuracy(void)
+{
+    static const char *kname[] = {"kernel scalar", "kernel sse2", "kernel avx2"};
+    spa_geocentric_cache cache;
+    spa_geocentric geo;
+    spa_stepper step;
+    spa_site site;
+    spa_batch batch;
+    benchstats_s st;
+    benchref_s r;
+    spa_data spa, day;
+    double zen, azm, inc;
+    int pass = 1, i, j, k, best;
+
+    printf("accuracy against %d reference points\n", nrefs);
+    printf("  %-28s %12s %10s %12s %10s\n", "path", "max deg", "tol", "max rts h", "tol");
+
+    best = spa_select_term_kernel(SPA_KERNEL_AVX2);
+    for(k = SPA_KERNEL_SCALAR; k <= best; k++)
+    {
+        spa_select_term_kernel(k);
+        memset(&st, 0, sizeof(st));
+        for(i = 0; i < nrefs; i++)
+        {
+            spa = refs[i].in;
+            spa_calculate(&spa);
+            BenchCompare(&st, &refs[i], &spa, 1);
+        }
+        pass &= BenchReport(kname[k], &st, BENCHTOLEXACT, BENCHTOLRTS);
+    }
+    spa_select_term_kernel(best);
+
+    memset(&st, 0, sizeof(st));
+    memset(&cache, 0, sizeof(cache));
+    for(i = 0; i < nrefs; i++)
+    {
+        spa = refs[i].in;
+        spa_calculate_cached(&spa, &cache);
+        BenchCompare(&st, &refs[i], &spa, 1);
+    }
+    pass &= BenchReport("spa_calculate_cached", &st, BENCHTOLEXACT, BENCHTOLRTS);
+
+    memset(&st, 0, sizeof(st));
+    for(i = 0; i < nrefs; i++)
+    {
+        spa = refs[i].in;
+        if(spa_site_init(&site, &spa) != 0) { st.maxang = HUGE_VAL; continue; }
+        spa_calculate_geocentric(julian_day(spa.year, spa.month, spa.day, spa.hour, spa.minute,
+                                            spa.second, spa.delta_ut1, spa.timezone),
+                                 spa.delta_t, &geo);
+        spa_calculate_site(&spa, &site, &geo);
+        BenchCompare(&st, &refs[i], &spa, 1);
+    }
+    pass &= BenchReport("spa_calculate_site", &st, BENCHTOLEXACT, BENCHTOLRTS);
+
+    memset(&st, 0, sizeof(st));
+    for(i = 0; i < nrefs; i++)
+    {
+        spa = refs[i].in;
+        spa.function = SPA_ZA_INC;
+        batch.count = 1;
+        batch.year = &spa.year;  batch.month = &spa.month;   batch.day = &spa.day;
+        batch.hour = &spa.hour;  batch.minute = &spa.minute; batch.second = &spa.second;
+        batch.zenith = &zen;     batch.azimuth = &azm;       batch.incidence = &inc;
+        spa_calculate_batch(&spa, &batch);
+        spa.zenith = zen;
+        spa.azimuth = azm;
+        spa.incidence = inc;
+        BenchCompare(&st, &refs[i], &spa, 0);
+    }
+    pass &= BenchReport("spa_calculate_batch", &st, BENCHTOLEXACT, -1.0);
+
+    // Whole days of minutes, where the batch works from its per chunk expansions
+    memset(&st, 0, sizeof(st));
+    for(i = 0; i < nrefs; i += BENCHBATCHDAY)
+    {
+        spa = refs[i].in;
+        spa.function = SPA_ZA_INC;
+        BenchBatchDay(&spa, &batch);
+        spa_calculate_batch(&spa, &batch);
+        for(j = 0; j < BENCHBATCH; j++)
+        {
+            day = spa;
+            day.hour = batch.hour[j];
+            day.minute = batch.minute[j];
+            spa_calculate(&day);
+            r.zenith = day.zenith;
+            r.azimuth = day.azimuth;
+            r.incidence = day.incidence;
+            day.zenith = batch.zenith[j];
+            day.azimuth = batch.azimuth[j];
+            day.incidence = batch.incidence[j];
+            BenchCompare(&st, &r, &day, 0);
+        }
+    }
+    pass &= BenchReport("spa_calculate_batch (days)", &st, BENCHTOLBATCH, -1.0);
+
+    // Open each window a few hours earlier so the point is interpolated, not a window end
+    memset(&st, 0, sizeof(st));
+    for(i = 0; i < nrefs; i++)
+    {
+        spa_stepper_init(&step, SPA_STEP_WINDOW);
+        spa = refs[i].in;
+        spa.function = SPA_ZA_INC;
+        spa.timezone += BENCHSTEPLEAD;
+        spa_calculate_step(&spa, &step);
+        spa.timezone -= BENCHSTEPLEAD;
+        spa_calculate_step(&spa, &step);
+        BenchCompare(&st, &refs[i], &spa, 0);
+    }
+    pass &= BenchReport("spa_calculate_step", &st, BENCHTOLSTEP, -1.0);
+
+    memset(&st, 0, sizeof(st));
+    for(i = 0; i < nrefs; i++)
+    {
+        spa = refs[i].in;
+        spa.function = SPA_ZA_INC;
+        if(spa_cheb_calculate(&eph, &spa) != 0) { st.maxang = HUGE_VAL; }
+        BenchCompare(&st, &refs[i], &spa, 0);
+    }
+    pass &= BenchReport("spa_cheb_calculate", &st, BENCHTOLCHEB, -1.0);
+
+    memset(&st, 0, sizeof(st));
+    for(i = 0; i < nrefs; i++)
+    {
+        spa = refs[i].in;
+        spa.function = SPA_ZA_INC;
+        if(spa_site_init(&site, &spa) != 0 || spa_cheb_calculate_site(&eph, &site, &spa) != 0)
+        {
+            st.maxang = HUGE_VAL;
+        }
+        BenchCompare(&st, &refs[i], &spa, 0);
+    }
+    pass &= BenchReport("spa_cheb_calculate_site", &st, BENCHTOLCHEB, -1.0);
+
+    memset(&st, 0, sizeof(st));
+    for(i = 0; i < nrefs; i++)
+    {
+        spa = refs[i].in;
+        spa.function = SPA_ZA_INC;
+        spa_calculate_float(&spa);
+        BenchCompare(&st, &refs[i], &spa, 0);
+    }
+    pass &= BenchReport("spa_calculate_float", &st, BENCHTOLFLOAT, -1.0);
+
+    return pass;
+}
+
+/** \brief Sort comparison for the timing samples
+ *
+ * \param two doubles
+ * \return int order
+ */
+static int BenchCompareSamples(const void *a, const void *b)
+{
+    double da = *(const double *)a, db = *(const double *)b;
+
+    return (da > db) - (da < db);
+}
+
+/** \brief Print mean and percentiles of the timing samples
+ *
+ * \param name, number of samples
+ * \return double median
+ */
+static double BenchPrint(const char *name, int n)
+{
+    double sum = 0.0;
+    int i;
+
+    for(i = 0; i < n; i++) { sum += samples[i]; }
+    qsort(samples, n, sizeof(double), BenchCompareSamples);
+    printf("  %-40s %9.0f %9.0f %9.0f %9.0f\n", name, sum / n, samples[n / 2],
+           samples[(int)(n * 0.9)], samples[(int)(n * 0.99)]);
+
+    return samples[n / 2];
+}
+
+/** \brief Time the SPA stages, function codes and fast paths
+ *
+ * \param void
+ * \return void
+ */
+static void BenchTiming(void)
+{
+    static const char *fname[] = {"spa_calculate SPA_ZA", "spa_calculate SPA_ZA_INC",
+                                  "spa_calculate SPA_ZA_RTS", "spa_calculate SPA_ALL"};
+    spa_geocentric_cache cache;
+    spa_geocentric geo;
+    spa_stepper step;
+    spa_site site;
+    spa_batch batch;
+    spa_data spa, day;
+    double x[5], dpsi, deps, t0, tbatch, tloop;
+    int i, f, j;
+
+    printf("\ntiming, %d calls each [ns/call]\n", ncalls);
+    printf("  %-40s %9s %9s %9s %9s\n", "stage / path", "mean", "p50", "p90", "p99");
+
+    for(i = 0; i < ncalls; i++)
+    {
+        spa = inputs[i % BENCHINPUTS];
+        t0 = BenchNow();
+        sink = julian_day(spa.year, spa.month, spa.day, spa.hour, spa.minute, spa.second,
+                          spa.delta_ut1, spa.timezone);
+        samples[i] = BenchNow() - t0;
+    }
+    BenchPrint("julian_day", ncalls);
+
+    for(i = 0; i < ncalls; i++)
+    {
+        spa = inputs[i % BENCHINPUTS];
+        t0 = BenchNow();
+        sink = earth_heliocentric_longitude((spa.year - 2000) / 1000.0);
+        samples[i] = BenchNow() - t0;
+    }
+    BenchPrint("earth_heliocentric_longitude", ncalls);
+
+    for(i = 0; i < ncalls; i++)
+    {
+        spa = inputs[i % BENCHINPUTS];
+        for(j = 0; j < 5; j++) { x[j] = spa.latitude * (j + 1); }
+        t0 = BenchNow();
+        nutation_longitude_and_obliquity((spa.year - 2000) / 100.0, x, &dpsi, &deps);
+        samples[i] = BenchNow() - t0;
+        sink = dpsi + deps;
+    }
+    BenchPrint("nutation_longitude_and_obliquity", ncalls);
+
+    for(i = 0; i < ncalls; i++)
+    {
+        spa = inputs[i % BENCHINPUTS];
+        spa.function = SPA_ZA;
+        spa_calculate(&spa);
+        t0 = BenchNow();
+        calculate_eot_and_sun_rise_transit_set(&spa);
+        samples[i] = BenchNow() - t0;
+        sink = spa.sunrise;
+    }
+    BenchPrint("calculate_eot_and_sun_rise_transit_set", ncalls);
+
+    for(f = SPA_ZA; f <= SPA_ALL; f++)
+    {
+        for(i = 0; i < ncalls; i++)
+        {
+            spa = inputs[i % BENCHINPUTS];
+            spa.function = f;
+            t0 = BenchNow();
+            spa_calculate(&spa);
+            samples[i] = BenchNow() - t0;
+            sink = spa.zenith;
+        }
+        BenchPrint(fname[f], ncalls);
+    }
+
+    // Many sites at the same instants, as in the yield simulator
+    memset(&cache, 0, sizeof(cache));
+    for(i = 0; i < ncalls; i++)
+    {
+        spa = inputs[i % BENCHINPUTS];
+        spa.year = inputs[i / 64 % BENCHINPUTS].year;
+        spa.month = inputs[i / 64 % BENCHINPUTS].month;
+        spa.day = inputs[i / 64 % BENCHINPUTS].day;
+        spa.hour = inputs[i / 64 % BENCHINPUTS].hour;
+        spa.minute = inputs[i / 64 % BENCHINPUTS].minute;
+        spa.second = inputs[i / 64 % BENCHINPUTS].second;
+        spa.timezone = 0;
+        spa.function = SPA_ZA_INC;
+        t0 = BenchNow();
+        spa_calculate_cached(&spa, &cache);
+        samples[i] = BenchNow() - t0;
+        sink = spa.zenith;
+    }
+    BenchPrint("spa_calculate_cached (64 sites/instant)", ncalls);
+
+    // One site, a day of consecutive minutes, timed per day as a batch and as a loop
+    spa = inputs[0];
+    spa.function = SPA_ZA_INC;
+    spa.second = 0.0;
+    BenchBatchDay(&spa, &batch);
+    for(i = 0; i < ncalls / BENCHBATCH + 1; i++)
+    {
+        t0 = BenchNow();
+        spa_calculate_batch(&spa, &batch);
+        samples[i] = (BenchNow() - t0) / BENCHBATCH;
+    }
+    tbatch = BenchPrint("spa_calculate_batch (per point)", ncalls / BENCHBATCH + 1);
+
+    for(i = 0; i < ncalls / BENCHBATCH + 1; i++)
+    {
+        t0 = BenchNow();
+        for(j = 0; j < BENCHBATCH; j++)
+        {
+            day = spa;
+            day.hour = batch.hour[j];
+            day.minute = batch.minute[j];
+            spa_calculate(&day);
+            sink = day.zenith;
+        }
+        samples[i] = (BenchNow() - t0) / BENCHBATCH;
+    }
+    tloop = BenchPrint("spa_calculate loop (per point)", ncalls / BENCHBATCH + 1);
+    printf("  %-40s %9.1fx (p50)\n", "batch speedup over the loop", tloop / tbatch);
+
+    // One site, control ticks
+    spa = inputs[0];
+    spa.function = SPA_ZA_INC;
+    spa.hour = 0;
+    spa.minute = 0;
+    spa.second = 0;
+    spa_stepper_init(&step, SPA_STEP_WINDOW);
+    for(i = 0; i < ncalls; i++)
+    {
+        spa.second = (i * BENCHSTEPSEC) % 60;
+        spa.minute = (i * BENCHSTEPSEC) / 60 % 60;
+        spa.hour   = (i * BENCHSTEPSEC) / 3600 % 24;
+        t0 = BenchNow();
+        spa_calculate_step(&spa, &step);
+        samples[i] = BenchNow() - t0;
+        sink = spa.zenith;
+    }
+    BenchPrint("spa_calculate_step (10 s ticks)", ncalls);
+
+    for(i = 0; i < ncalls; i++)
+    {
+        spa = inputs[i % BENCHINPUTS];
+        spa.function = SPA_ZA_INC;
+        t0 = BenchNow();
+        spa_cheb_calculate(&eph, &spa);
+        samples[i] = BenchNow() - t0;
+        sink = spa.zenith;
+    }
+    BenchPrint("spa_cheb_calculate", ncalls);
+
+    for(i = 0; i < ncalls; i++)
+    {
+        spa = inputs[i % BENCHINPUTS];
+        t0 = BenchNow();
+        spa_cheb_geocentric(&eph, julian_day(spa.year, spa.month, spa.day, spa.hour,
+                                             spa.minute, spa.second, spa.delta_ut1,
+                                             spa.timezone), &geo);
+        samples[i] = BenchNow() - t0;
+        sink = geo.alpha;
+    }
+    BenchPrint("spa_cheb_geocentric", ncalls);
+
+    // The site is prepared once, as a tracker does, for both timings below
+    for(i = 0; i < ncalls; i++)
+    {
+        spa = inputs[i % BENCHINPUTS];
+        spa.function = SPA_ZA_INC;
+        spa_site_init(&site, &spa);
+        t0 = BenchNow();
+        spa_cheb_calculate_site(&eph, &site, &spa);
+        samples[i] = BenchNow() - t0;
+        sink = spa.zenith;
+    }
+    BenchPrint("spa_cheb_calculate_site", ncalls);
+
+    spa = inputs[0];
+    spa.function = SPA_ZA_INC;
+    spa.hour = 0;
+    spa.minute = 0;
+    spa.second = 0;
+    spa_site_init(&site, &spa);
+    for(i = 0; i < ncalls; i++)
+    {
+        spa.second = (i * BENCHSTEPSEC) % 60;
+        spa.minute = (i * BENCHSTEPSEC) / 60 % 60;
+        spa.hour   = (i * BENCHSTEPSEC) / 3600 % 24;
+        t0 = BenchNow();
+        spa_cheb_calculate_site(&eph, &site, &spa);
+        samples[i] = BenchNow() - t0;
+        sink = spa.zenith;
+    }
+    BenchPrint("spa_cheb_calculate_site (10 s ticks)", ncalls);
+
+    for(i = 0; i < ncalls; i++)
+    {
+        spa = inputs[i % BENCHINPUTS];
+        spa.function = SPA_ZA_INC;
+        t0 = BenchNow();
+        spa_calculate_float(&spa);
+        samples[i] = BenchNow() - t0;
+        sink = spa.zenith;
+    }
+    BenchPrint("spa_calculate_float", ncalls);
+}
+
+/** \brief Parse arguments, check accuracy and run the timing
+ *
+ * \param int/char* argument count and arguments
+ * \return int 0 when all accuracy checks pass, 1 otherwise
+ */
+int main(int argc, char *argv[])
+{
+    const char *reffile = BENCHREFFILE;
+    int generate = 0, pass, i;
+
+    for(i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-n") == 0 && i + 1 < argc) { ncalls = atoi(argv[++i]); }
+        else if(strcmp(argv[i], "-g") == 0)             { generate = 1; }
+        else                                            { reffile = argv[i]; }
+    }
+    if(ncalls < 100) { ncalls = 100; }
+
+    if(generate)
+    {
+        if(!BenchWriteReference(reffile))
+        {
+            fprintf(stderr, "Cannot write %s\n", reffile);
+            return 1;
+        }
+        printf("Wrote %d reference points to %s\n", BENCHREFPTS, reffile);
+        return 0;
+    }
+
+    if(BenchReadReference(reffile) == 0)
+    {
+        fprintf(stderr, "Cannot read reference dataset %s (create it with -g)\n", reffile);
+        return 1;
+    }
+
+    // The ephemeris covers the whole reference span, 2000 to 2101 plus time zones
+    if(!spa_cheb_fit(&eph, julian_day(1999, 12, 31, 0, 0, 0.0, 0.0, 0.0), 102.0 * 365.25,
+                     CHEBSEGDAYS, CHEBDEGREE, BENCHDELTAT))
+    {
+        fprintf(stderr, "Cannot fit the Chebyshev ephemeris\n");
+        return 1;
+    }
+
+    samples = (double *)malloc(sizeof(double) * ncalls);
+    if(samples == NULL) { return 1; }
+    for(i = 0; i < BENCHINPUTS; i++) { BenchRandomInput(&inputs[i], SPA_ZA_INC); }
+
+    pass = BenchAccuracy();
+    BenchTiming();
+
+    printf("\n%s\n", pass ? "accuracy ok" : "ACCURACY REGRESSION");
+
+    spa_cheb_free(&eph);
+    free(samples);
+    free(refs);
+
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,319 @@
+/** \file spacheb.c
+ *  \brief Chebyshev-compressed solar ephemeris
+ *
+ *  The geocentric outputs of spa.c (right ascension, declination, sidereal time correction,
+ *  radius vector, nutation longitude and true obliquity) are fitted with piecewise Chebyshev
+ *  polynomials over a span of julian days.  Evaluating the polynomials replaces the periodic
+ *  term and nutation series, so only the cheap observer stage of the SPA is run per call.
+ *  The fit error against spa.c is measured when fitting and stored in the file header.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "spa.h"
+#include "spacheb.h"
+
+#define CHEBPI 3.1415926535897932384626433832795028841971
+
+/** \brief Wrap an angle difference into -180 to 180 degrees
+ *
+ * \param double difference in degrees
+ * \return double wrapped difference
+ */
+static double ChebWrap180(double diff)
+{
+    while(diff > 180.0) { diff -= 360.0; }
+    while(diff < -180.0) { diff += 360.0; }
+    return diff;
+}
+
+/** \brief Evaluate the Chebyshev series of every quantity of a segment with Clenshaw's recurrence
+ *
+ * The recurrences of the quantities are stepped together, so they overlap instead of each
+ * waiting on its own chain of multiplies.
+ *
+ * \param segment coefficients, degree, t in -1 to 1, output array of CHEB_COUNT values
+ * \return void
+ */
+static void ChebEvaluate(const double *c, int degree, double t, double *val)
+{
+    double b0[CHEB_COUNT] = {0.0}, b1[CHEB_COUNT] = {0.0}, b2;
+    double t2 = 2.0 * t;
+    int n = degree + 1;
+    int k, q;
+
+    for(k = degree; k >= 1; k--)
+    {
+        for(q = 0; q < CHEB_COUNT; q++)
+        {
+            b2 = b1[q];
+            b1[q] = b0[q];
+            b0[q] = c[q*n + k] + t2 * b1[q] - b2;
+        }
+    }
+    for(q = 0; q < CHEB_COUNT; q++)
+    {
+        val[q] = c[q*n] + t * b0[q] - b1[q];
+    }
+}
+
+/** \brief Fill the quantities that are fitted from a full geocentric evaluation
+ *
+ * \param geocentric values, output array of CHEB_COUNT values
+ * \return void
+ */
+static void ChebQuantities(const spa_geocentric *geo, double *val)
+{
+    val[CHEB_ALPHA]   = geo->alpha;
+    val[CHEB_DELTA]   = geo->delta;
+    val[CHEB_NUCORR]  = geo->nu - geo->nu0;
+    val[CHEB_R]       = geo->r;
+    val[CHEB_DELPSI]  = geo->del_psi;
+    val[CHEB_EPSILON] = geo->epsilon;
+}
+
+/** \brief Fit a Chebyshev ephemeris over a span of julian days
+ *
+ * \param ephemeris to fill, first UT julian day, span and segment length in days,
+ *        polynomial degree, delta_t in seconds
+ * \return int 1 on success, 0 on invalid arguments or allocation failure
+ */
+int spa_cheb_fit(chebephem_s *eph, double jd_start, double days, double seg_days, int degree,
+                 double delta_t)
+{
+    spa_geocentric geo;
+    double node[CHEBMAXDEG+1][CHEB_COUNT];
+    double val[CHEB_COUNT], fit[CHEB_COUNT];
+    double half, mid, t, sum, err;
+    double *c;
+    int n, s, q, j, k;
+
+    if(degree < 1 || degree > CHEBMAXDEG || seg_days <= 0.0 || days <= 0.0) { return 0; }
+
+    memset(eph, 0, sizeof(*eph));
+    strcpy(eph->hdr.magic, CHEBMAGIC);
+    eph->hdr.version  = CHEBVERSION;
+    eph->hdr.degree   = degree;
+    eph->hdr.segments = (int32_t)ceil(days / seg_days);
+    eph->hdr.jd_start = jd_start;
+    eph->hdr.seg_days = seg_days;
+    eph->hdr.delta_t  = delta_t;
+
+    eph->coef = (double *)malloc(sizeof(double) * eph->hdr.segments * CHEB_COUNT * (degree+1));
+    if(eph->coef == NULL) { return 0; }
+
+    n = degree + 1;
+    half = seg_days / 2.0;
+
+    for(s = 0; s < eph->hdr.segments; s++)
+    {
+        mid = jd_start + s * seg_days + half;
+
+        // Sample at the Chebyshev nodes, unwrapping right ascension within the segment
+        for(j = 0; j < n; j++)
+        {
+            t = cos(CHEBPI * (j + 0.5) / n);
+            spa_calculate_geocentric(mid + t * half, delta_t, &geo);
+            ChebQuantities(&geo, node[j]);
+            if(j > 0)
+            {
+                node[j][CHEB_ALPHA] = node[j-1][CHEB_ALPHA] +
+                                      ChebWrap180(node[j][CHEB_ALPHA] - node[j-1][CHEB_ALPHA]);
+            }
+        }
+
+        for(q = 0; q < CHEB_COUNT; q++)
+        {
+            c = eph->coef + ((size_t)s * CHEB_COUNT + q) * n;
+            for(k = 0; k < n; k++)
+            {
+                sum = 0.0;
+                for(j = 0; j < n; j++)
+                {
+                    sum += node[j][q] * cos(CHEBPI * k * (j + 0.5) / n);
+                }
+                c[k] = 2.0 * sum / n;
+            }
+            c[0] /= 2.0;
+        }
+
+        // Measure the error between the nodes against the full calculation
+        for(j = 0; j < CHEBCHECKPTS; j++)
+        {
+            t = -1.0 + 2.0 * (j + 0.5) / CHEBCHECKPTS;
+            spa_calculate_geocentric(mid + t * half, delta_t, &geo);
+            ChebQuantities(&geo, val);
+            ChebEvaluate(eph->coef + (size_t)s * CHEB_COUNT * n, degree, t, fit);
+            err = fabs(ChebWrap180(fit[CHEB_ALPHA] - val[CHEB_ALPHA]));
+            if(fabs(fit[CHEB_DELTA] - val[CHEB_DELTA]) > err) { err = fabs(fit[CHEB_DELTA] - val[CHEB_DELTA]); }
+            if(fabs(fit[CHEB_NUCORR] - val[CHEB_NUCORR]) > err) { err = fabs(fit[CHEB_NUCORR] - val[CHEB_NUCORR]); }
+            if(err > eph->hdr.max_error) { eph->hdr.max_error = err; }
+        }
+    }
+
+    return 1;
+}
+
+/** \brief Save a Chebyshev ephemeris to a binary file
+ *
+ * \param ephemeris, file name
+ * \return int 1 on success, 0 on failure
+ */
+int spa_cheb_save(const chebephem_s *eph, const char *fname)
+{
+    FILE *fp;
+    size_t ncoef = (size_t)eph->hdr.segments * CHEB_COUNT * (eph->hdr.degree+1);
+    int status;
+
+    fp = fopen(fname, "wb");
+    if(fp == NULL) { return 0; }
+
+    status = (fwrite(&eph->hdr, sizeof(eph->hdr), 1, fp) == 1) &&
+             (fwrite(eph->coef, sizeof(double), ncoef, fp) == ncoef);
+    fclose(fp);
+
+    return status;
+}
+
+/** \brief Load a Chebyshev ephemeris from a binary file
+ *
+ * \param ephemeris to fill, file name
+ * \return int 1 on success, 0 on failure
+ */
+int spa_cheb_load(chebephem_s *eph, const char *fname)
+{
+    FILE *fp;
+    size_t ncoef;
+
+    memset(eph, 0, sizeof(*eph));
+    fp = fopen(fname, "rb");
+    if(fp == NULL) { return 0; }
+
+    if(fread(&eph->hdr, sizeof(eph->hdr), 1, fp) != 1 ||
+       strncmp(eph->hdr.magic, CHEBMAGIC, sizeof(eph->hdr.magic)) != 0 ||
+       eph->hdr.version != CHEBVERSION ||
+       eph->hdr.degree < 1 || eph->hdr.degree > CHEBMAXDEG ||
+       eph->hdr.segments < 1 || eph->hdr.seg_days <= 0.0)
+    {
+        fclose(fp);
+        return 0;
+    }
+
+    ncoef = (size_t)eph->hdr.segments * CHEB_COUNT * (eph->hdr.degree+1);
+    eph->coef = (double *)malloc(sizeof(double) * ncoef);
+    if(eph->coef == NULL || fread(eph->coef, sizeof(double), ncoef, fp) != ncoef)
+    {
+        fclose(fp);
+        spa_cheb_free(eph);
+        return 0;
+    }
+    fclose(fp);
+
+    return 1;
+}
+
+/** \brief Release the coefficients of a Chebyshev ephemeris
+ *
+ * \param ephemeris
+ * \return void
+ */
+void spa_cheb_free(chebephem_s *eph)
+{
+    free(eph->coef);
+    eph->coef = NULL;
+}
+
+/** \brief Evaluate the geocentric values used by the observer stage of the SPA
+ *
+ * Only the time values, alpha, delta, nu0, nu, r, del_psi and epsilon are filled.
+ *
+ * \param ephemeris, UT julian day, geocentric structure to fill
+ * \return int 1 on success, 0 if jd is outside the fitted span
+ */
+int spa_cheb_geocentric(const chebephem_s *eph, double jd, spa_geocentric *geo)
+{
+    const double *c;
+    double half = eph->hdr.seg_days / 2.0;
+    double val[CHEB_COUNT];
+    double t;
+    int n = eph->hdr.degree + 1;
+    int s;
+
+    t = (jd - eph->hdr.jd_start) / eph->hdr.seg_days;
+    s = (int)floor(t);
+    if(s == eph->hdr.segments && t == s) { s--; }
+    if(s < 0 || s >= eph->hdr.segments) { return 0; }
+
+    t = (jd - (eph->hdr.jd_start + s * eph->hdr.seg_days + half)) / half;
+    c = eph->coef + (size_t)s * CHEB_COUNT * n;
+
+    memset(geo, 0, sizeof(*geo));
+    geo->jd      = jd;
+    geo->delta_t = eph->hdr.delta_t;
+    geo->jc      = julian_century(jd);
+    geo->jde     = julian_ephemeris_day(jd, geo->delta_t);
+    geo->jce     = julian_ephemeris_century(geo->jde);
+    geo->jme     = julian_ephemeris_millennium(geo->jce);
+
+    ChebEvaluate(c, eph->hdr.degree, t, val);
+    geo->alpha   = limit_degrees(val[CHEB_ALPHA]);
+    geo->delta   = val[CHEB_DELTA];
+    geo->r       = val[CHEB_R];
+    geo->del_psi = val[CHEB_DELPSI];
+    geo->epsilon = val[CHEB_EPSILON];
+    geo->nu0     = greenwich_mean_sidereal_time(jd, geo->jc);
+    geo->nu      = geo->nu0 + val[CHEB_NUCORR];
+
+    return 1;
+}
+
+/** \brief Calculate SPA outputs from the Chebyshev ephemeris instead of the full series
+ *
+ * The ephemeris must have been fitted with the same delta_t as the structure.  SPA_ZA and
+ * SPA_ZA_INC use the ephemeris only, rise/transit/set still run the full series.
+ *
+ * \param ephemeris, spa_data structure with inputs filled in
+ * \return int spa_calculate() error code, or CHEBRANGEERR outside the fitted span
+ */
+int spa_cheb_calculate(const chebephem_s *eph, spa_data *spa)
+{
+    spa_geocentric geo;
+    double jd;
+
+    jd = julian_day(spa->year, spa->month, spa->day, spa->hour, spa->minute, spa->second,
+                    spa->delta_ut1, spa->timezone);
+
+    if(spa->delta_t != eph->hdr.delta_t || !spa_cheb_geocentric(eph, jd, &geo))
+    {
+        return CHEBRANGEERR;
+    }
+
+    return spa_calculate_observer(spa, &geo);
+}
+
+/** \brief Calculate SPA outputs from the Chebyshev ephemeris for a prepared site
+ *
+ * Same outputs as spa_cheb_calculate(), without the input validation and the site terms
+ * that spa_site_init() already calculated.  Dates outside the fitted span are still rejected.
+ *
+ * \param ephemeris, site prepared from the structure, spa_data structure with inputs filled in
+ * \return int 0 on success, CHEBRANGEERR outside the fitted span
+ */
+int spa_cheb_calculate_site(const chebephem_s *eph, const spa_site *site, spa_data *spa)
+{
+    spa_geocentric geo;
+    double jd;
+
+    jd = julian_day(spa->year, spa->month, spa->day, spa->hour, spa->minute, spa->second,
+                    spa->delta_ut1, spa->timezone);
+
+    if(spa->delta_t != eph->hdr.delta_t || !spa_cheb_geocentric(eph, jd, &geo))
+    {
+        return CHEBRANGEERR;
+    }
+    spa_calculate_site(spa, site, &geo);
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+/** \file spacheb.h
+ *  \brief Chebyshev-compressed solar ephemeris - header
+*/
+
+#ifndef SPACHEB_H
+#define SPACHEB_H
+
+#include <stdint.h>
+#include "spa.h"
+
+// File format constants
+#define CHEBMAGIC    "SPTCHEB"
+#define CHEBVERSION  1
+
+// Fit constants
+#define CHEBMAXDEG   20
+#define CHEBDEGREE   12      // Default polynomial degree per segment
+#define CHEBSEGDAYS  8.0     // Default segment length [days]
+#define CHEBCHECKPTS 16      // Points per segment used to measure the fit error
+
+// Returned by spa_cheb_calculate() outside the fitted span (spa.c uses codes 1 to 17)
+#define CHEBRANGEERR 18
+
+// Fitted quantities, all in degrees except the radius vector
+enum {
+    CHEB_ALPHA,     ///< geocentric right ascension (unwrapped within a segment)
+    CHEB_DELTA,     ///< geocentric declination
+    CHEB_NUCORR,    ///< sidereal time minus mean sidereal time (nu - nu0)
+    CHEB_R,         ///< earth radius vector [AU]
+    CHEB_DELPSI,    ///< nutation longitude
+    CHEB_EPSILON,   ///< ecliptic true obliquity
+    CHEB_COUNT
+};
+
+/** File header, followed by segments*CHEB_COUNT*(degree+1) native-endian doubles.
+ *  Segment s covers jd_start+s*seg_days to jd_start+(s+1)*seg_days (UT julian days).
+ */
+typedef struct chebheader
+{
+    char magic[8];          ///< CHEBMAGIC, NUL terminated
+    int32_t version;        ///< CHEBVERSION
+    int32_t degree;         ///< polynomial degree per segment
+    int32_t segments;       ///< number of segments
+    int32_t reserved;
+    double jd_start;        ///< first julian day covered
+    double seg_days;        ///< segment length [days]
+    double delta_t;         ///< delta_t used for the fit [seconds]
+    double max_error;       ///< largest alpha/delta/nu error against spa.c [degrees]
+} chebheader_s;
+
+typedef struct chebephem
+{
+    chebheader_s hdr;
+    double *coef;           ///< coefficients, segment major then quantity
+} chebephem_s;
+
+// Function Prototypes
+int spa_cheb_fit(chebephem_s *eph, double jd_start, double days, double seg_days, int degree,
+                 double delta_t);
+int spa_cheb_save(const chebephem_s *eph, const char *fname);
+int spa_cheb_load(chebephem_s *eph, const char *fname);
+void spa_cheb_free(chebephem_s *eph);
+int spa_cheb_geocentric(const chebephem_s *eph, double jd, spa_geocentric *geo);
+int spa_cheb_calculate(const chebephem_s *eph, spa_data *spa);
+
+// Evaluating the ephemeris takes about 150 ns.  A full spa_cheb_calculate() call takes about
+// 0.8-1 us because it also validates the inputs and runs the observer stage of spa.c.  For a
+// tracker at a fixed site, spa_cheb_calculate_site() reuses a site prepared by spa_site_init()
+// and takes about 450-550 ns per tick (spabench, 10 s ticks).  That misses the few-hundred-ns
+// target: about ten trigonometric calls in the observer stage remain on every call.
+int spa_cheb_calculate_site(const chebephem_s *eph, const spa_site *site, spa_data *spa);
+
+#endif // SPACHEB_H
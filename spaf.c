@@ -0,0 +1,315 @@
+/** \file spaf.c
+ *  \brief Reduced-precision (single precision) solar position
+ *
+ *  A float version of spa_calculate() for SPA_ZA and SPA_ZA_INC, meant for running many
+ *  trackers on small controllers where 0.0003 degrees is far finer than the stepper can use.
+ *  The earth periodic terms are truncated to those larger than 1e-6 radians between 2000
+ *  and 2100, the nutation series to the terms above 0.03 arc seconds, and everything is summed
+ *  in float.  The julian day and its time arguments, the mean sidereal time and the mean
+ *  motion term of the heliocentric longitude stay in double, since a float cannot resolve
+ *  seconds over a century.
+*/
+
+#include <math.h>
+#include "spa.h"
+#include "spaf.h"
+
+#define SPAFD2R  0.017453292519943296f      // degrees to radians
+#define SPAFR2D  57.295779513082321f        // radians to degrees
+#define SPAF2PI  6.283185307179586477       // two pi in double
+#define SPAFL1MEAN 6283.31966747            // mean motion term of L1 [radians per millennium]
+
+#define L_COUNT_F 3
+#define B_COUNT_F 1
+#define R_COUNT_F 2
+#define Y_COUNT_F 9
+
+#define L_MAX_SUBCOUNT_F 33
+#define B_MAX_SUBCOUNT_F 2
+#define R_MAX_SUBCOUNT_F 17
+
+static const int l_subcount_f[L_COUNT_F] = {33,2,1};
+static const int b_subcount_f[B_COUNT_F] = {2};
+static const int r_subcount_f[R_COUNT_F] = {17,2};
+
+// Earth periodic terms A, B, C from spa.c, truncated (A in 1e-8 radians or AU)
+static const float L_TERMS_F[L_COUNT_F][L_MAX_SUBCOUNT_F][3]=
+{
+    {
+        {175347046.0f,0.0f,0.0f},
+        {3341656.0f,4.6692568f,6283.07585f},
+        {34894.0f,4.6261f,12566.1517f},
+        {3497.0f,2.7441f,5753.3849f},
+        {3418.0f,2.8289f,3.5231f},
+        {3136.0f,3.6277f,77713.7715f},
+        {2676.0f,4.4181f,7860.4194f},
+        {2343.0f,6.1352f,3930.2097f},
+        {1324.0f,0.7425f,11506.7698f},
+        {1273.0f,2.0371f,529.691f},
+        {1199.0f,1.1096f,1577.3435f},
+        {990.0f,5.233f,5884.927f},
+        {902.0f,2.045f,26.298f},
+        {857.0f,3.508f,398.149f},
+        {780.0f,1.179f,5223.694f},
+        {753.0f,2.533f,5507.553f},
+        {505.0f,4.583f,18849.228f},
+        {492.0f,4.205f,775.523f},
+        {357.0f,2.92f,0.067f},
+        {317.0f,5.849f,11790.629f},
+        {284.0f,1.899f,796.298f},
+        {271.0f,0.315f,10977.079f},
+        {243.0f,0.345f,5486.778f},
+        {206.0f,4.806f,2544.314f},
+        {205.0f,1.869f,5573.143f},
+        {202.0f,2.458f,6069.777f},
+        {156.0f,0.833f,213.299f},
+        {132.0f,3.411f,2942.463f},
+        {126.0f,1.083f,20.775f},
+        {115.0f,0.645f,0.98f},
+        {103.0f,0.636f,4694.003f},
+        {102.0f,0.976f,15720.839f},
+        {102.0f,4.267f,7.114f},
+    },
+    {
+        {206059.0f,2.678235f,6283.07585f},
+        {4303.0f,2.6351f,12566.1517f},
+    },
+    {
+        {52919.0f,0.0f,0.0f},
+    }
+};
+
+static const float B_TERMS_F[B_COUNT_F][B_MAX_SUBCOUNT_F][3]=
+{
+    {
+        {280.0f,3.199f,84334.662f},
+        {102.0f,5.422f,5507.553f},
+    }
+};
+
+static const float R_TERMS_F[R_COUNT_F][R_MAX_SUBCOUNT_F][3]=
+{
+    {
+        {100013989.0f,0.0f,0.0f},
+        {1670700.0f,3.0984635f,6283.07585f},
+        {13956.0f,3.05525f,12566.1517f},
+        {3084.0f,5.1985f,77713.7715f},
+        {1628.0f,1.1739f,5753.3849f},
+        {1576.0f,2.8469f,7860.4194f},
+        {925.0f,5.453f,11506.77f},
+        {542.0f,4.564f,3930.21f},
+        {472.0f,3.661f,5884.927f},
+        {346.0f,0.964f,5507.553f},
+        {329.0f,5.9f,5223.694f},
+        {307.0f,0.299f,5573.143f},
+        {243.0f,4.273f,11790.629f},
+        {212.0f,5.847f,1577.344f},
+        {186.0f,5.022f,10977.079f},
+        {175.0f,3.012f,18849.228f},
+        {110.0f,5.055f,5486.778f},
+    },
+    {
+        {103019.0f,1.10749f,6283.07585f},
+        {1721.0f,1.0644f,12566.1517f},
+    }
+};
+
+// Nutation terms from spa.c, truncated (coefficients in 0.0001 arc seconds)
+static const signed char Y_TERMS_F[Y_COUNT_F][5]=
+{
+    {0,0,0,0,1},
+    {-2,0,0,2,2},
+    {0,0,0,2,2},
+    {0,0,0,0,2},
+    {0,1,0,0,0},
+    {0,0,1,0,0},
+    {-2,1,0,2,2},
+    {0,0,0,2,1},
+    {0,0,1,2,2}
+};
+
+static const float PE_TERMS_F[Y_COUNT_F][4]=
+{
+    {-171996.0f,-174.2f,92025.0f,8.9f},
+    {-13187.0f,-1.6f,5736.0f,-3.1f},
+    {-2274.0f,-0.2f,977.0f,-0.5f},
+    {2062.0f,0.2f,-895.0f,0.5f},
+    {1426.0f,-3.4f,54.0f,-0.1f},
+    {712.0f,0.1f,-7.0f,0.0f},
+    {-517.0f,1.2f,224.0f,-0.6f},
+    {-386.0f,-0.4f,200.0f,0.0f},
+    {-301.0f,0.0f,129.0f,-0.1f}
+};
+
+/** \brief Wrap an angle into 0 to 360 degrees
+ *
+ * \param float angle in degrees
+ * \return float wrapped angle
+ */
+static float SpafLimitDegrees(float degrees)
+{
+    float limited = degrees - 360.0f * floorf(degrees / 360.0f);
+
+    return (limited < 0.0f) ? limited + 360.0f : limited;
+}
+
+/** \brief Sum the series of one earth periodic term table and combine them with Horner's rule
+ *
+ * \param first term of the table, terms per series, terms used per series, series count,
+ *        julian ephemeris millennium
+ * \return float sum in 1e-8 radians or AU
+ */
+static float SpafEarthValue(const float *terms, int stride, const int *subcount, int count,
+                            float jme)
+{
+    const float *term;
+    float value = 0.0f, sum;
+    int i, j;
+
+    for(i = count - 1; i >= 0; i--)
+    {
+        term = terms + i * stride * 3;
+        sum = 0.0f;
+        for(j = 0; j < subcount[i]; j++, term += 3)
+        {
+            sum += term[0] * cosf(term[1] + term[2] * jme);
+        }
+        value = value * jme + sum;
+    }
+
+    return value;
+}
+
+/** \brief Calculate the sun position with float arithmetic and truncated term tables
+ *
+ * Fills the same outputs as spa_calculate() for SPA_ZA and SPA_ZA_INC.  Rise/transit/set
+ * requests and dates outside SPAFYEARMIN to SPAFYEARMAX are passed on to spa_calculate().
+ *
+ * \param spa_data structure with inputs filled in
+ * \return int spa_calculate() error code
+ */
+int spa_calculate_float(spa_data *spa)
+{
+    double lmean;
+    float t, tc, l, b, r, x[5], arg, sum_psi = 0.0f, sum_eps = 0.0f, u;
+    float lat, eps, lam, bet, alpha, delta, h, xi, uu, y, xx, da, dp, hp, e0, dele, az, zr, sr;
+    int result, i, j;
+
+    if((spa->function == SPA_ZA_RTS) || (spa->function == SPA_ALL) ||
+       (spa->year < SPAFYEARMIN) || (spa->year > SPAFYEARMAX))
+    {
+        return spa_calculate(spa);
+    }
+
+    result = validate_inputs(spa);
+    if(result != 0) { return result; }
+
+    // Time arguments in double
+    spa->jd  = julian_day(spa->year, spa->month, spa->day, spa->hour, spa->minute, spa->second,
+                          spa->delta_ut1, spa->timezone);
+    spa->jc  = julian_century(spa->jd);
+    spa->jde = julian_ephemeris_day(spa->jd, spa->delta_t);
+    spa->jce = julian_ephemeris_century(spa->jde);
+    spa->jme = julian_ephemeris_millennium(spa->jce);
+    spa->nu0 = greenwich_mean_sidereal_time(spa->jd, spa->jc);
+    lmean = fmod(SPAFL1MEAN * spa->jme, SPAF2PI);
+    t  = (float)spa->jme;
+    tc = (float)spa->jce;
+
+    // Heliocentric and geocentric position
+    l = (float)lmean +
+        SpafEarthValue(L_TERMS_F[0][0], L_MAX_SUBCOUNT_F, l_subcount_f, L_COUNT_F, t) / 1.0e8f;
+    b = SpafEarthValue(B_TERMS_F[0][0], B_MAX_SUBCOUNT_F, b_subcount_f, B_COUNT_F, t) / 1.0e8f;
+    r = SpafEarthValue(R_TERMS_F[0][0], R_MAX_SUBCOUNT_F, r_subcount_f, R_COUNT_F, t) / 1.0e8f;
+    spa->l = SpafLimitDegrees(l * SPAFR2D);
+    spa->b = b * SPAFR2D;
+    spa->r = r;
+    spa->theta = SpafLimitDegrees((float)spa->l + 180.0f);
+    spa->beta  = -spa->b;
+
+    // Nutation and obliquity
+    x[0] = 297.85036f + tc * (445267.111480f + tc * (-0.0019142f + tc / 189474.0f));
+    x[1] = 357.52772f + tc * (35999.050340f + tc * (-0.0001603f - tc / 300000.0f));
+    x[2] = 134.96298f + tc * (477198.867398f + tc * (0.0086972f + tc / 56250.0f));
+    x[3] = 93.27191f + tc * (483202.017538f + tc * (-0.0036825f + tc / 327270.0f));
+    x[4] = 125.04452f + tc * (-1934.136261f + tc * (0.0020708f + tc / 450000.0f));
+    spa->x0 = x[0]; spa->x1 = x[1]; spa->x2 = x[2]; spa->x3 = x[3]; spa->x4 = x[4];
+
+    for(i = 0; i < Y_COUNT_F; i++)
+    {
+        arg = 0.0f;
+        for(j = 0; j < 5; j++) { arg += x[j] * Y_TERMS_F[i][j]; }
+        arg *= SPAFD2R;
+        sum_psi += (PE_TERMS_F[i][0] + tc * PE_TERMS_F[i][1]) * sinf(arg);
+        sum_eps += (PE_TERMS_F[i][2] + tc * PE_TERMS_F[i][3]) * cosf(arg);
+    }
+    spa->del_psi     = sum_psi / 36000000.0f;
+    spa->del_epsilon = sum_eps / 36000000.0f;
+
+    u = t / 10.0f;
+    spa->epsilon0 = 84381.448f + u * (-4680.93f + u * (-1.55f + u * (1999.25f + u * (-51.38f +
+                    u * (-249.67f + u * (-39.05f + u * (7.12f + u * (27.87f + u * (5.79f +
+                    u * 2.45f)))))))));
+    eps = (float)spa->del_epsilon + (float)spa->epsilon0 / 3600.0f;
+    spa->epsilon = eps;
+
+    spa->del_tau = -20.4898f / (3600.0f * r);
+    lam = (float)spa->theta + (float)spa->del_psi + (float)spa->del_tau;
+    spa->lamda = lam;
+    spa->nu = (float)spa->nu0 + (float)spa->del_psi * cosf(eps * SPAFD2R);
+
+    // Geocentric right ascension and declination
+    lam *= SPAFD2R;
+    eps *= SPAFD2R;
+    bet = (float)spa->beta * SPAFD2R;
+    alpha = SpafLimitDegrees(atan2f(sinf(lam) * cosf(eps) - tanf(bet) * sinf(eps), cosf(lam)) * SPAFR2D);
+    delta = asinf(sinf(bet) * cosf(eps) + cosf(bet) * sinf(eps) * sinf(lam)) * SPAFR2D;
+    spa->alpha = alpha;
+    spa->delta = delta;
+
+    // Observer values
+    lat = (float)spa->latitude * SPAFD2R;
+    h   = SpafLimitDegrees((float)spa->nu + (float)spa->longitude - alpha);
+    xi  = 8.794f / (3600.0f * r) * SPAFD2R;
+    uu  = atanf(0.99664719f * tanf(lat));
+    y   = 0.99664719f * sinf(uu) + (float)spa->elevation * sinf(lat) / 6378140.0f;
+    xx  = cosf(uu) + (float)spa->elevation * cosf(lat) / 6378140.0f;
+    spa->h  = h;
+    spa->xi = xi * SPAFR2D;
+
+    h *= SPAFD2R;
+    delta *= SPAFD2R;
+    da = atan2f(-xx * sinf(xi) * sinf(h), cosf(delta) - xx * sinf(xi) * cosf(h));
+    dp = atan2f((sinf(delta) - y * sinf(xi)) * cosf(da), cosf(delta) - xx * sinf(xi) * cosf(h));
+    hp = h - da;
+    spa->del_alpha   = da * SPAFR2D;
+    spa->delta_prime = dp * SPAFR2D;
+    spa->alpha_prime = alpha + da * SPAFR2D;
+    spa->h_prime     = hp * SPAFR2D;
+
+    e0 = asinf(sinf(lat) * sinf(dp) + cosf(lat) * cosf(dp) * cosf(hp)) * SPAFR2D;
+    dele = 0.0f;
+    if(e0 >= -1.0f * (0.26667f + (float)spa->atmos_refract))
+    {
+        dele = ((float)spa->pressure / 1010.0f) * (283.0f / (273.0f + (float)spa->temperature)) *
+               1.02f / (60.0f * tanf((e0 + 10.3f / (e0 + 5.11f)) * SPAFD2R));
+    }
+    spa->e0     = e0;
+    spa->del_e  = dele;
+    spa->e      = e0 + dele;
+    spa->zenith = 90.0f - (e0 + dele);
+
+    az = SpafLimitDegrees(atan2f(sinf(hp), cosf(hp) * sinf(lat) - tanf(dp) * cosf(lat)) * SPAFR2D);
+    spa->azimuth_astro = az;
+    spa->azimuth       = SpafLimitDegrees(az + 180.0f);
+
+    if(spa->function == SPA_ZA_INC)
+    {
+        zr = (float)spa->zenith * SPAFD2R;
+        sr = (float)spa->slope * SPAFD2R;
+        spa->incidence = acosf(cosf(zr) * cosf(sr) + sinf(sr) * sinf(zr) *
+                               cosf((az - (float)spa->azm_rotation) * SPAFD2R)) * SPAFR2D;
+    }
+
+    return 0;
+}
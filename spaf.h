@@ -0,0 +1,17 @@
+/** \file spaf.h
+ *  \brief Reduced-precision (single precision) solar position - header
+*/
+
+#ifndef SPAF_H
+#define SPAF_H
+
+#include "spa.h"
+
+// Span the truncated term tables were selected for, other years use spa_calculate()
+#define SPAFYEARMIN 2000
+#define SPAFYEARMAX 2100
+
+// Function Prototypes
+int spa_calculate_float(spa_data *spa);
+
+#endif // SPAF_H
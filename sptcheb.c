@@ -0,0 +1,57 @@
+/** \file sptcheb.c
+ *  \brief Command line generator for Chebyshev solar ephemeris files
+ *
+ *  Usage: sptcheb year outfile [days] [segment days] [degree] [delta_t]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "spa.h"
+#include "spacheb.h"
+#include "panel.h"
+
+#define CHEBDAYS 366.0
+
+/** \brief Fit an ephemeris starting on January 1 of the given year and save it
+ *
+ * \param int/char* argument count and arguments
+ * \return int 0 on success, 1 on failure
+ */
+int main(int argc, char *argv[])
+{
+    chebephem_s eph;
+    double days = CHEBDAYS;
+    double segdays = CHEBSEGDAYS;
+    double deltat = DELTAT;
+    int degree = CHEBDEGREE;
+    int year;
+
+    if(argc < 3)
+    {
+        fprintf(stderr, "Usage: %s year outfile [days] [segment days] [degree] [delta_t]\n", argv[0]);
+        return 1;
+    }
+    year = atoi(argv[1]);
+    if(argc > 3) { days = atof(argv[3]); }
+    if(argc > 4) { segdays = atof(argv[4]); }
+    if(argc > 5) { degree = atoi(argv[5]); }
+    if(argc > 6) { deltat = atof(argv[6]); }
+
+    if(!spa_cheb_fit(&eph, julian_day(year, 1, 1, 0, 0, 0.0, 0.0, 0.0), days, segdays, degree, deltat))
+    {
+        fprintf(stderr, "Unable to fit ephemeris\n");
+        return 1;
+    }
+    if(!spa_cheb_save(&eph, argv[2]))
+    {
+        fprintf(stderr, "Unable to write %s\n", argv[2]);
+        spa_cheb_free(&eph);
+        return 1;
+    }
+
+    printf("%s: %d segments of %.1f days, degree %d, max error %.2e degrees\n",
+           argv[2], eph.hdr.segments, eph.hdr.seg_days, eph.hdr.degree, eph.hdr.max_error);
+    spa_cheb_free(&eph);
+
+    return 0;
+}
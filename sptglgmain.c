@@ -108,6 +108,7 @@ void Input(GlgObject GhDrawing,GlgAnyType client_data,GlgAnyType call_data)
         else
         {
             TrackOn = 0;
+            StTrackStop();
             GlgSetDResource(SptDrawing,"Elevation1/DisableInput",0);
             GlgSetDResource(SptDrawing,"Azimuth1/DisableInput",0);
             GlgSetDResource(SptDrawing,"LED1/DisableInput",STOFF);
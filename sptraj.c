@@ -0,0 +1,63 @@
+/** \file sptraj.c
+ *  \brief Command line generator for solar trajectory tables
+ *
+ *  Usage: sptraj outfile year [step] [latitude longitude elevation]
+*/
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "traj.h"
+#include "panel.h"
+
+/** \brief Generate a trajectory table for one year at a site
+ *
+ * \param int/char* argument count and arguments
+ * \return int 0 on success, 1 on failure
+ */
+int main(int argc, char *argv[])
+{
+    trajheader_s site;
+    struct tm jan1 = {0};
+    time_t start, end;
+    int year;
+
+    if(argc < 3 || argc == 5 || argc == 6)
+    {
+        fprintf(stderr, "Usage: %s outfile year [step] [latitude longitude elevation]\n", argv[0]);
+        return 1;
+    }
+
+    memset(&site, 0, sizeof(site));
+    year = atoi(argv[2]);
+    site.step = (argc > 3) ? atoi(argv[3]) : TRAJSTEP;
+    site.latitude = (argc > 6) ? atof(argv[4]) : DLATITUDE;
+    site.longitude = (argc > 6) ? atof(argv[5]) : DLONGITUDE;
+    site.elevation = (argc > 6) ? atof(argv[6]) : DALTITUDE;
+    site.slope = DSLOPE;
+    site.azm_rotation = DAZROT;
+    site.pressure = TRAJPRESS;
+    site.temperature = TRAJTEMP;
+    site.delta_t = DELTAT;
+
+    jan1.tm_year = year - 1900;
+    jan1.tm_mday = 1;
+    start = timegm(&jan1);
+    jan1.tm_year++;
+    end = timegm(&jan1);
+    site.start = start;
+    site.count = (end - start) / (site.step > 0 ? site.step : 1) + 1;
+
+    if(!traj_generate(argv[1], &site))
+    {
+        fprintf(stderr, "Unable to generate %s\n", argv[1]);
+        return 1;
+    }
+
+    printf("%s: %lld points every %d s from %d-01-01 00:00 UTC at %.5f, %.5f\n", argv[1],
+           (long long)site.count, site.step, year, site.latitude, site.longitude);
+
+    return 0;
+}
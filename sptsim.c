@@ -0,0 +1,266 @@
+/** \file sptsim.c
+ *  \brief Annual tracking yield simulator
+ *
+ *  Compares fixed-tilt, single-axis and the two-axis StTrackSun() strategy over a year at
+ *  one minute resolution for one or more sites.  Days are handed out to worker threads, each
+ *  minute's geocentric sun position is calculated once and shared by all sites, and the yield
+ *  is the cosine of the incidence angle summed while the sun is up (equivalent full sun hours).
+ *  The geocentric position comes from a Chebyshev ephemeris fitted at start up (about 1e-10
+ *  degrees from spa.c), or from the full series with -e.
+ *
+ *  Usage: sptsim year [-t threads] [-e] latitude,longitude[,elevation] ...
+*/
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "spa.h"
+#include "spacheb.h"
+#include "panel.h"
+
+#define SIMMAXSITES   256
+#define SIMMAXTHREADS 64
+#define SIMSAXLIM     60.0      // Single axis rotation limit [degrees]
+#define SIMSTEPMIN    1         // Minutes between samples
+
+enum { SIM_FIXED, SIM_SINGLE, SIM_DUAL, SIM_COUNT };
+
+typedef struct simsite
+{
+    double latitude;
+    double longitude;
+    double elevation;
+} simsite_s;
+
+typedef struct simjob
+{
+    int year;
+    int days;
+    int nextday;                ///< next day to hand out, protected by lock
+    int exact;                  ///< use the full series instead of the ephemeris
+    chebephem_s eph;
+    int nsites;
+    simsite_s site[SIMMAXSITES];
+    pthread_mutex_t lock;
+} simjob_s;
+
+typedef struct simworker
+{
+    pthread_t thread;
+    simjob_s *job;
+    double yield[SIMMAXSITES][SIM_COUNT];   ///< Equivalent full sun minutes
+} simworker_s;
+
+/** \brief Clamp a value to a range
+ *
+ * \param value, minimum, maximum
+ * \return double clamped value
+ */
+static double SimClamp(double val, double min, double max)
+{
+    return (val < min) ? min : ((val > max) ? max : val);
+}
+
+/** \brief Add one sample of the three strategies for one site
+ *
+ * \param worker, site index, spa_data with zenith, azimuth and fixed-tilt incidence
+ * \return void
+ */
+static void SimAccumulate(simworker_s *w, int i, const spa_data *csp)
+{
+    double sz = sin(deg2rad(csp->zenith));
+    double se = sz * sin(deg2rad(csp->azimuth));     // sun vector east, north, up
+    double sn = sz * cos(deg2rad(csp->azimuth));
+    double su = cos(deg2rad(csp->zenith));
+    double paz, pel, rot, cinc;
+
+    if(csp->zenith >= 90.0) { return; }
+
+    // Fixed tilt facing the equator at latitude slope
+    cinc = cos(deg2rad(csp->incidence));
+    if(cinc > 0.0) { w->yield[i][SIM_FIXED] += cinc; }
+
+    // Horizontal north-south axis tracking east to west
+    rot = deg2rad(SimClamp(rad2deg(atan2(se, su)), -SIMSAXLIM, SIMSAXLIM));
+    cinc = se * sin(rot) + su * cos(rot);
+    if(cinc > 0.0) { w->yield[i][SIM_SINGLE] += cinc; }
+
+    // Two axis within the hardware limits of the tracker
+    paz = deg2rad(SimClamp(csp->azimuth, STMINAZDEG, STMAXAZDEG));
+    pel = deg2rad(SimClamp(90.0 - csp->zenith, STMINELDEG, STMAXELDEG));
+    cinc = se * cos(pel) * sin(paz) + sn * cos(pel) * cos(paz) + su * sin(pel);
+    if(cinc > 0.0) { w->yield[i][SIM_DUAL] += cinc; }
+}
+
+/** \brief Worker thread, simulates whole days until none are left
+ *
+ * \param simworker_s pointer
+ * \return NULL
+ */
+static void *SimWorker(void *arg)
+{
+    simworker_s *w = (simworker_s *)arg;
+    simjob_s *job = w->job;
+    spa_data csp[SIMMAXSITES];
+    spa_geocentric geo;
+    struct tm date = {0};
+    time_t when;
+    double jd;
+    int day, minute, i;
+
+    for(i = 0; i < job->nsites; i++)
+    {
+        memset(&csp[i], 0, sizeof(spa_data));
+        csp[i].delta_t       = DELTAT;
+        csp[i].latitude      = job->site[i].latitude;
+        csp[i].longitude     = job->site[i].longitude;
+        csp[i].elevation     = job->site[i].elevation;
+        csp[i].pressure      = TRAJPRESS;
+        csp[i].temperature   = TRAJTEMP;
+        csp[i].slope         = fabs(job->site[i].latitude);
+        csp[i].azm_rotation  = (job->site[i].latitude >= 0.0) ? 0.0 : 180.0;
+        csp[i].atmos_refract = DATMREF;
+        csp[i].function      = SPA_ZA_INC;
+    }
+
+    while(1)
+    {
+        pthread_mutex_lock(&job->lock);
+        day = job->nextday++;
+        pthread_mutex_unlock(&job->lock);
+        if(day >= job->days) { break; }
+
+        date.tm_year = job->year - 1900;
+        date.tm_mon = 0;
+        date.tm_mday = 1 + day;
+        when = timegm(&date);
+        gmtime_r(&when, &date);
+
+        for(minute = 0; minute < 1440; minute += SIMSTEPMIN)
+        {
+            jd = julian_day(date.tm_year + 1900, date.tm_mon + 1, date.tm_mday,
+                            minute / 60, minute % 60, 0.0, 0.0, 0.0);
+            if(job->exact || !spa_cheb_geocentric(&job->eph, jd, &geo))
+            {
+                spa_calculate_geocentric(jd, DELTAT, &geo);
+            }
+            for(i = 0; i < job->nsites; i++)
+            {
+                csp[i].year   = date.tm_year + 1900;
+                csp[i].month  = date.tm_mon + 1;
+                csp[i].day    = date.tm_mday;
+                csp[i].hour   = minute / 60;
+                csp[i].minute = minute % 60;
+                if(spa_calculate_observer(&csp[i], &geo) == 0)
+                {
+                    SimAccumulate(w, i, &csp[i]);
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/** \brief Parse arguments, run the workers and report the yield per site
+ *
+ * \param int/char* argument count and arguments
+ * \return int 0 on success, 1 on failure
+ */
+int main(int argc, char *argv[])
+{
+    static simjob_s job;
+    static simworker_s worker[SIMMAXTHREADS];
+    struct tm jan1 = {0};
+    struct timespec t0, t1;
+    double total[SIM_COUNT];
+    int nthreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int i, j, k;
+
+    if(argc < 3)
+    {
+        fprintf(stderr, "Usage: %s year [-t threads] [-e] latitude,longitude[,elevation] ...\n",
+                argv[0]);
+        return 1;
+    }
+
+    job.year = atoi(argv[1]);
+    for(i = 2; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+        {
+            nthreads = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "-e") == 0)
+        {
+            job.exact = 1;
+        }
+        else if(job.nsites < SIMMAXSITES &&
+                sscanf(argv[i], "%lf,%lf,%lf", &job.site[job.nsites].latitude,
+                       &job.site[job.nsites].longitude, &job.site[job.nsites].elevation) >= 2)
+        {
+            job.nsites++;
+        }
+        else
+        {
+            fprintf(stderr, "Bad argument: %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if(job.nsites == 0) { return 1; }
+    if(nthreads < 1) { nthreads = 1; }
+    if(nthreads > SIMMAXTHREADS) { nthreads = SIMMAXTHREADS; }
+
+    jan1.tm_year = job.year - 1900;
+    jan1.tm_mday = 1;
+    job.days = (int)(-timegm(&jan1) / 86400);
+    jan1.tm_year++;
+    job.days += (int)(timegm(&jan1) / 86400);
+    pthread_mutex_init(&job.lock, NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    if(!job.exact &&
+       !spa_cheb_fit(&job.eph, julian_day(job.year, 1, 1, 0, 0, 0.0, 0.0, 0.0), job.days + 1.0,
+                     CHEBSEGDAYS, CHEBDEGREE, DELTAT))
+    {
+        job.exact = 1;
+    }
+    for(k = 0; k < nthreads; k++)
+    {
+        worker[k].job = &job;
+        pthread_create(&worker[k].thread, NULL, SimWorker, &worker[k]);
+    }
+    for(k = 0; k < nthreads; k++)
+    {
+        pthread_join(worker[k].thread, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    spa_cheb_free(&job.eph);
+
+    printf("%d: %d days, %d site(s), %d thread(s), %s, %.3f s\n", job.year, job.days, job.nsites,
+           nthreads, job.exact ? "full series" : "ephemeris",
+           (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9);
+    printf("%10s %11s %10s %10s %10s %8s %8s\n", "latitude", "longitude", "fixed h",
+           "1-axis h", "2-axis h", "1-axis", "2-axis");
+    for(i = 0; i < job.nsites; i++)
+    {
+        for(j = 0; j < SIM_COUNT; j++)
+        {
+            total[j] = 0.0;
+            for(k = 0; k < nthreads; k++) { total[j] += worker[k].yield[i][j] * SIMSTEPMIN / 60.0; }
+        }
+        printf("%10.5f %11.5f %10.1f %10.1f %10.1f %7.1f%% %7.1f%%\n",
+               job.site[i].latitude, job.site[i].longitude,
+               total[SIM_FIXED], total[SIM_SINGLE], total[SIM_DUAL],
+               100.0 * (total[SIM_SINGLE] / total[SIM_FIXED] - 1.0),
+               100.0 * (total[SIM_DUAL] / total[SIM_FIXED] - 1.0));
+    }
+
+    return 0;
+}
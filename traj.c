@@ -0,0 +1,219 @@
+/** \file traj.c
+ *  \brief Precomputed solar trajectory table
+ *
+ *  A trajectory file holds the sun azimuth, zenith and surface incidence for one site at a
+ *  fixed step.  At run time the file is memory-mapped read only, so it is paged in lazily
+ *  and a lookup is an interpolation between two points instead of a spa_calculate() call.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "spa.h"
+#include "traj.h"
+
+#define TRAJCHUNK 8640      // Points calculated per spa_calculate_batch() call
+
+/** \brief Calculate the trajectory for a site and write it to a file
+ *
+ * \param file name, header with the site, surface, atmosphere, start, step and count
+ * \return int 1 on success, 0 on failure
+ */
+int traj_generate(const char *fname, const trajheader_s *site)
+{
+    FILE *fp;
+    trajheader_s hdr = *site;
+    trajpoint_s *pts;
+    spa_data csp = {0};
+    spa_batch batch = {0};
+    int *year, *month, *day, *hour, *minute;
+    double *second, *zenith, *azimuth, *incidence;
+    struct tm ut;
+    time_t when;
+    int64_t done;
+    int i, n, status = 1;
+
+    if(hdr.step <= 0 || hdr.count <= 0) { return 0; }
+    memset(hdr.magic, 0, sizeof(hdr.magic));
+    strcpy(hdr.magic, TRAJMAGIC);
+    hdr.version = TRAJVERSION;
+
+    csp.timezone      = 0.0;
+    csp.delta_ut1     = 0.0;
+    csp.delta_t       = hdr.delta_t;
+    csp.latitude      = hdr.latitude;
+    csp.longitude     = hdr.longitude;
+    csp.elevation     = hdr.elevation;
+    csp.pressure      = hdr.pressure;
+    csp.temperature   = hdr.temperature;
+    csp.slope         = hdr.slope;
+    csp.azm_rotation  = hdr.azm_rotation;
+    csp.atmos_refract = 0.5667;
+    csp.function      = SPA_ZA_INC;
+
+    year = malloc(TRAJCHUNK * sizeof(int));
+    month = malloc(TRAJCHUNK * sizeof(int));
+    day = malloc(TRAJCHUNK * sizeof(int));
+    hour = malloc(TRAJCHUNK * sizeof(int));
+    minute = malloc(TRAJCHUNK * sizeof(int));
+    second = malloc(TRAJCHUNK * sizeof(double));
+    zenith = malloc(TRAJCHUNK * sizeof(double));
+    azimuth = malloc(TRAJCHUNK * sizeof(double));
+    incidence = malloc(TRAJCHUNK * sizeof(double));
+    pts = malloc(TRAJCHUNK * sizeof(trajpoint_s));
+    fp = fopen(fname, "wb");
+
+    if(!year || !month || !day || !hour || !minute || !second || !zenith || !azimuth ||
+       !incidence || !pts || fp == NULL ||
+       fwrite(&hdr, sizeof(hdr), 1, fp) != 1)
+    {
+        status = 0;
+    }
+
+    batch.year = year;
+    batch.month = month;
+    batch.day = day;
+    batch.hour = hour;
+    batch.minute = minute;
+    batch.second = second;
+    batch.zenith = zenith;
+    batch.azimuth = azimuth;
+    batch.incidence = incidence;
+
+    for(done = 0; status && done < hdr.count; done += n)
+    {
+        n = (hdr.count - done > TRAJCHUNK) ? TRAJCHUNK : (int)(hdr.count - done);
+        for(i = 0; i < n; i++)
+        {
+            when = (time_t)(hdr.start + (done + i) * hdr.step);
+            gmtime_r(&when, &ut);
+            year[i] = ut.tm_year + 1900;
+            month[i] = ut.tm_mon + 1;
+            day[i] = ut.tm_mday;
+            hour[i] = ut.tm_hour;
+            minute[i] = ut.tm_min;
+            second[i] = ut.tm_sec;
+        }
+        batch.count = n;
+        if(spa_calculate_batch(&csp, &batch) != 0) { status = 0; break; }
+
+        for(i = 0; i < n; i++)
+        {
+            pts[i].azimuth = (float)azimuth[i];
+            pts[i].zenith = (float)zenith[i];
+            pts[i].incidence = (float)incidence[i];
+        }
+        if(fwrite(pts, sizeof(trajpoint_s), n, fp) != (size_t)n) { status = 0; }
+    }
+
+    if(fp != NULL && fclose(fp) != 0) { status = 0; }
+    free(year); free(month); free(day); free(hour); free(minute);
+    free(second); free(zenith); free(azimuth); free(incidence); free(pts);
+
+    return status;
+}
+
+/** \brief Memory-map a trajectory file
+ *
+ * \param table to fill, file name
+ * \return int 1 on success, 0 if the file is missing, truncated or of another version
+ */
+int traj_open(trajtable_s *table, const char *fname)
+{
+    struct stat st;
+    const trajheader_s *hdr;
+    void *map;
+    int fd;
+
+    memset(table, 0, sizeof(*table));
+    fd = open(fname, O_RDONLY);
+    if(fd < 0) { return 0; }
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(trajheader_s))
+    {
+        close(fd);
+        return 0;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) { return 0; }
+
+    hdr = (const trajheader_s *)map;
+    if(strncmp(hdr->magic, TRAJMAGIC, sizeof(hdr->magic)) != 0 || hdr->version != TRAJVERSION ||
+       hdr->step <= 0 || hdr->count <= 0 ||
+       (size_t)st.st_size < sizeof(trajheader_s) + hdr->count * sizeof(trajpoint_s))
+    {
+        munmap(map, st.st_size);
+        return 0;
+    }
+
+    table->hdr = hdr;
+    table->pts = (const trajpoint_s *)(hdr + 1);
+    table->maplen = st.st_size;
+
+    return 1;
+}
+
+/** \brief Unmap a trajectory file
+ *
+ * \param table
+ * \return void
+ */
+void traj_close(trajtable_s *table)
+{
+    if(table->hdr != NULL) { munmap((void *)table->hdr, table->maplen); }
+    memset(table, 0, sizeof(*table));
+}
+
+/** \brief Check whether an open table was generated for a site
+ *
+ * \param table, site latitude and longitude
+ * \return int 1 if the site is within TRAJSITETOL of the table site
+ */
+int traj_matches_site(const trajtable_s *table, double latitude, double longitude)
+{
+    return table->hdr != NULL &&
+           fabs(table->hdr->latitude - latitude) <= TRAJSITETOL &&
+           fabs(table->hdr->longitude - longitude) <= TRAJSITETOL;
+}
+
+/** \brief Interpolate the sun position at a time from an open table
+ *
+ * \param table, UTC time, pointers for azimuth, zenith and incidence [degrees]
+ * \return int 1 on success, 0 if the time is outside the table
+ */
+int traj_lookup(const trajtable_s *table, time_t when, double *azimuth, double *zenith,
+                double *incidence)
+{
+    const trajpoint_s *p0, *p1;
+    int64_t offset, idx;
+    double frac, daz;
+
+    if(table->hdr == NULL || when < table->hdr->start) { return 0; }
+
+    offset = (int64_t)when - table->hdr->start;
+    idx = offset / table->hdr->step;
+    frac = (double)(offset % table->hdr->step) / table->hdr->step;
+    if(idx >= table->hdr->count || (idx == table->hdr->count - 1 && frac > 0.0)) { return 0; }
+
+    p0 = &table->pts[idx];
+    p1 = (frac > 0.0) ? &table->pts[idx+1] : p0;
+
+    // Azimuth wraps through north
+    daz = p1->azimuth - p0->azimuth;
+    if(daz > 180.0) { daz -= 360.0; }
+    if(daz < -180.0) { daz += 360.0; }
+    *azimuth = p0->azimuth + frac * daz;
+    if(*azimuth < 0.0) { *azimuth += 360.0; }
+    if(*azimuth >= 360.0) { *azimuth -= 360.0; }
+
+    *zenith = p0->zenith + frac * (p1->zenith - p0->zenith);
+    *incidence = p0->incidence + frac * (p1->incidence - p0->incidence);
+
+    return 1;
+}
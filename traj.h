@@ -0,0 +1,62 @@
+/** \file traj.h
+ *  \brief Precomputed solar trajectory table - header
+*/
+
+#ifndef TRAJ_H
+#define TRAJ_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+// File format constants
+#define TRAJMAGIC   "SPTTRAJ"
+#define TRAJVERSION 1
+
+// Generation defaults
+#define TRAJSTEP    10          // Seconds between table points
+#define TRAJPRESS   1010.0      // Annual average pressure [millibars]
+#define TRAJTEMP    10.0        // Annual average temperature [degrees Celsius]
+#define TRAJSITETOL 0.01        // Largest lat/lon difference [degrees] for a table to match a site
+
+/** File header, followed by count trajpoint_s records starting at UTC time start */
+typedef struct trajheader
+{
+    char magic[8];          ///< TRAJMAGIC, NUL terminated
+    int32_t version;        ///< TRAJVERSION
+    int32_t step;           ///< seconds between points
+    int64_t start;          ///< UTC time of the first point [seconds since the epoch]
+    int64_t count;          ///< number of points
+    double latitude;        ///< site latitude [degrees]
+    double longitude;       ///< site longitude [degrees]
+    double elevation;       ///< site elevation [meters]
+    double slope;           ///< surface slope used for the incidence angle [degrees]
+    double azm_rotation;    ///< surface azimuth rotation used for the incidence angle [degrees]
+    double pressure;        ///< pressure used for refraction [millibars]
+    double temperature;     ///< temperature used for refraction [degrees Celsius]
+    double delta_t;         ///< delta_t used for the table [seconds]
+} trajheader_s;
+
+typedef struct trajpoint
+{
+    float azimuth;          ///< topocentric azimuth, eastward from north [degrees]
+    float zenith;           ///< topocentric zenith angle [degrees]
+    float incidence;        ///< surface incidence angle [degrees]
+} trajpoint_s;
+
+typedef struct trajtable
+{
+    const trajheader_s *hdr;    ///< mapped header, NULL when no table is open
+    const trajpoint_s *pts;     ///< mapped points
+    size_t maplen;              ///< length of the mapping
+} trajtable_s;
+
+// Function Prototypes
+int traj_generate(const char *fname, const trajheader_s *site);
+int traj_open(trajtable_s *table, const char *fname);
+void traj_close(trajtable_s *table);
+int traj_matches_site(const trajtable_s *table, double latitude, double longitude);
+int traj_lookup(const trajtable_s *table, time_t when, double *azimuth, double *zenith,
+                double *incidence);
+
+#endif // TRAJ_H
@@ -0,0 +1,318 @@
+/** \file ubx.c
+ *  \brief u-blox UBX binary protocol parser
+ *
+ *  Frames are parsed byte by byte as they arrive, so a frame may be split across reads.
+ *  Payload fields are read as little-endian integers at their documented offsets, which
+ *  keeps the parser independent of the host byte order and of structure packing.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ubx.h"
+
+/** \brief Read a little-endian unsigned 16-bit value
+ *
+ * \param bytes
+ * \return uint16_t value
+ */
+static uint16_t UbxU2(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/** \brief Read a little-endian unsigned 32-bit value
+ *
+ * \param bytes
+ * \return uint32_t value
+ */
+static uint32_t UbxU4(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/** \brief Read a little-endian signed 32-bit value
+ *
+ * \param bytes
+ * \return int32_t value
+ */
+static int32_t UbxI4(const uint8_t *p)
+{
+    return (int32_t)UbxU4(p);
+}
+
+/** \brief Decode a NAV-PVT payload
+ *
+ * \param payload of UBXPVTLEN bytes, ubxpvt_t structure
+ * \return void
+ */
+void ubx_parse_pvt(const uint8_t *p, ubxpvt_t *pvt)
+{
+    pvt->itow    = UbxU4(p + 0);
+    pvt->year    = UbxU2(p + 4);
+    pvt->month   = p[6];
+    pvt->day     = p[7];
+    pvt->hour    = p[8];
+    pvt->minute  = p[9];
+    pvt->second  = p[10];
+    pvt->valid   = p[11];
+    pvt->tacc    = UbxU4(p + 12);
+    pvt->nano    = UbxI4(p + 16);
+    pvt->fixtype = p[20];
+    pvt->flags   = p[21];
+    pvt->numsv   = p[23];
+    pvt->lon     = UbxI4(p + 24);
+    pvt->lat     = UbxI4(p + 28);
+    pvt->height  = UbxI4(p + 32);
+    pvt->hmsl    = UbxI4(p + 36);
+    pvt->hacc    = UbxU4(p + 40);
+    pvt->vacc    = UbxU4(p + 44);
+    pvt->veln    = UbxI4(p + 48);
+    pvt->vele    = UbxI4(p + 52);
+    pvt->veld    = UbxI4(p + 56);
+    pvt->gspeed  = UbxI4(p + 60);
+    pvt->headmot = UbxI4(p + 64);
+    pvt->sacc    = UbxU4(p + 68);
+    pvt->headacc = UbxU4(p + 72);
+    pvt->pdop    = UbxU2(p + 76);
+}
+
+/** \brief Decode a NAV-TIMEUTC payload
+ *
+ * \param payload of UBXTIMEUTCLEN bytes, ubxtimeutc_t structure
+ * \return void
+ */
+void ubx_parse_timeutc(const uint8_t *p, ubxtimeutc_t *utc)
+{
+    utc->itow   = UbxU4(p + 0);
+    utc->tacc   = UbxU4(p + 4);
+    utc->nano   = UbxI4(p + 8);
+    utc->year   = UbxU2(p + 12);
+    utc->month  = p[14];
+    utc->day    = p[15];
+    utc->hour   = p[16];
+    utc->minute = p[17];
+    utc->second = p[18];
+    utc->valid  = p[19];
+}
+
+/** \brief Hand a complete frame to the callback
+ *
+ * \param ubxstream_t structure with a checked frame
+ * \return int 1 if a record was passed to the callback, 0 if the frame has no parser
+ */
+static int UbxDispatch(ubxstream_t *s)
+{
+    ubxpvt_t pvt;
+    ubxtimeutc_t utc;
+    uint8_t cls = s->header[0], id = s->header[1];
+
+    if(cls == UBX_CLASS_NAV && id == UBX_NAV_PVT && s->length >= UBXPVTLEN)
+    {
+        ubx_parse_pvt(s->payload, &pvt);
+        if(s->callback != NULL) { s->callback(cls, id, &pvt, s->ctx); }
+        return 1;
+    }
+    if(cls == UBX_CLASS_NAV && id == UBX_NAV_TIMEUTC && s->length >= UBXTIMEUTCLEN)
+    {
+        ubx_parse_timeutc(s->payload, &utc);
+        if(s->callback != NULL) { s->callback(cls, id, &utc, s->ctx); }
+        return 1;
+    }
+
+    return 0;
+}
+
+/** \brief Prepare a streaming parser
+ *
+ * \param ubxstream_t structure, callback for valid frames, context passed to the callback
+ * \return void
+ */
+void ubx_stream_init(ubxstream_t *s, ubx_callback callback, void *ctx)
+{
+    memset(s, 0, sizeof(ubxstream_t));
+    s->state = UBX_STATE_SYNC1;
+    s->callback = callback;
+    s->ctx = ctx;
+}
+
+/** \brief Parse raw bytes
+ *
+ * Anything between frames, such as NMEA sentences the receiver still sends, is skipped
+ * while looking for the sync characters.
+ *
+ * \param ubxstream_t structure, data, number of bytes
+ * \return size_t number of records passed to the callback
+ */
+size_t ubx_stream_feed(ubxstream_t *s, const uint8_t *data, size_t len)
+{
+    const uint8_t *end = data + len;
+    const uint8_t *sync;
+    size_t records = 0, n, keep, i;
+    uint8_t c, cka, ckb;
+
+    while(data < end)
+    {
+        // Skip to the next sync character
+        if(s->state == UBX_STATE_SYNC1)
+        {
+            sync = (const uint8_t *)memchr(data, UBXSYNC1, end - data);
+            if(sync == NULL) { break; }
+            data = sync;
+        }
+        // Take the payload as a block rather than byte by byte, keeping what fits
+        else if(s->state == UBX_STATE_PAYLOAD)
+        {
+            n = s->length - s->count;
+            if(n > (size_t)(end - data)) { n = end - data; }
+            keep = (s->count < UBXMAXPAYLOAD) ? UBXMAXPAYLOAD - s->count : 0;
+            memcpy(s->payload + s->count, data, (n < keep) ? n : keep);
+            for(i = 0, cka = s->cka, ckb = s->ckb; i < n; i++)
+            {
+                cka += data[i];
+                ckb += cka;
+            }
+            s->cka = cka;
+            s->ckb = ckb;
+            s->count += n;
+            data += n;
+            if(s->count == s->length)
+            {
+                s->count = 0;
+                s->state = UBX_STATE_CK;
+            }
+            continue;
+        }
+        c = *data++;
+
+        switch(s->state)
+        {
+            case UBX_STATE_SYNC1:
+                s->state = UBX_STATE_SYNC2;
+                break;
+
+            case UBX_STATE_SYNC2:
+                if(c == UBXSYNC2)
+                {
+                    s->state = UBX_STATE_HEADER;
+                    s->count = 0;
+                    s->cka = 0;
+                    s->ckb = 0;
+                }
+                else if(c != UBXSYNC1)
+                {
+                    s->state = UBX_STATE_SYNC1;
+                }
+                break;
+
+            case UBX_STATE_HEADER:
+                s->header[s->count++] = c;
+                s->cka += c;
+                s->ckb += s->cka;
+                if(s->count == 4)
+                {
+                    s->length = UbxU2(s->header + 2);
+                    s->count = 0;
+                    s->state = (s->length > 0) ? UBX_STATE_PAYLOAD : UBX_STATE_CK;
+                    if(s->length > UBXMAXLENGTH)
+                    {
+                        // A false sync in other data, do not wait for a payload that long
+                        s->checksumerrors++;
+                        s->state = UBX_STATE_SYNC1;
+                    }
+                }
+                break;
+
+            case UBX_STATE_CK:
+                s->check[s->count++] = c;
+                if(s->count < 2) { break; }
+                s->state = UBX_STATE_SYNC1;
+                if(s->check[0] != s->cka || s->check[1] != s->ckb)
+                {
+                    s->checksumerrors++;
+                    break;
+                }
+                s->frames++;
+                if(s->length > UBXMAXPAYLOAD || !UbxDispatch(s))
+                {
+                    s->skipped++;
+                    break;
+                }
+                records++;
+                break;
+        }
+    }
+
+    return records;
+}
+
+/** \brief Memory-map a recorded UBX capture
+ *
+ * \param ubxcapture_t structure, file name
+ * \return int 1 on success, 0 on failure
+ */
+int ubx_capture_open(ubxcapture_t *cap, const char *fname)
+{
+    struct stat st;
+    void *map;
+    int fd;
+
+    memset(cap, 0, sizeof(*cap));
+    fd = open(fname, O_RDONLY);
+    if(fd < 0) { return 0; }
+    if(fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return 0;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED) { return 0; }
+
+    cap->map = (const uint8_t *)map;
+    cap->maplen = st.st_size;
+
+    return 1;
+}
+
+/** \brief Unmap a capture
+ *
+ * \param ubxcapture_t structure
+ * \return void
+ */
+void ubx_capture_close(ubxcapture_t *cap)
+{
+    if(cap->map != NULL) { munmap((void *)cap->map, cap->maplen); }
+    memset(cap, 0, sizeof(*cap));
+}
+
+/** \brief Feed a capture into a parser until a number of records have been produced
+ *
+ * \param ubxcapture_t structure, ubxstream_t structure, records wanted,
+ *        non-zero to restart at the end of the capture
+ * \return size_t records produced, less than max at the end of a capture that does not loop
+ */
+size_t ubx_capture_feed(ubxcapture_t *cap, ubxstream_t *s, size_t max, int loop)
+{
+    size_t records = 0;
+    int wraps = 0;
+
+    while(records < max && cap->maplen > 0)
+    {
+        if(cap->pos >= cap->maplen)
+        {
+            // Stop on a capture that produces nothing over a whole pass
+            if(!loop || (++wraps > 1 && records == 0)) { break; }
+            cap->pos = 0;
+            s->state = UBX_STATE_SYNC1;
+        }
+        records += ubx_stream_feed(s, cap->map + cap->pos++, 1);
+    }
+
+    return records;
+}
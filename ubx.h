@@ -0,0 +1,137 @@
+/** \file ubx.h
+ *  \brief u-blox UBX binary protocol parser - header
+*/
+
+#ifndef UBX_H
+#define UBX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Frame layout: 0xB5 0x62 class id length(2, little endian) payload checksum(2)
+#define UBXSYNC1 0xB5
+#define UBXSYNC2 0x62
+#define UBXMAXPAYLOAD 256       // longer frames are checked and skipped
+#define UBXMAXLENGTH 4096       // longer lengths are taken as a false sync
+
+// Messages with a parser
+#define UBX_CLASS_NAV 0x01
+#define UBX_NAV_PVT 0x07
+#define UBX_NAV_TIMEUTC 0x21
+#define UBXPVTLEN 92
+#define UBXTIMEUTCLEN 20
+
+// NAV-PVT fixType
+#define UBX_FIX_NONE 0
+#define UBX_FIX_DR 1
+#define UBX_FIX_2D 2
+#define UBX_FIX_3D 3
+#define UBX_FIX_GNSSDR 4
+#define UBX_FIX_TIME 5
+
+// NAV-PVT flags and NAV-TIMEUTC valid bits
+#define UBX_PVT_GNSSFIXOK 0x01
+#define UBX_PVT_DIFFSOLN 0x02
+#define UBX_PVT_VALIDDATE 0x01
+#define UBX_PVT_VALIDTIME 0x02
+#define UBX_TIMEUTC_VALIDUTC 0x04
+
+// Parser states
+#define UBX_STATE_SYNC1 0
+#define UBX_STATE_SYNC2 1
+#define UBX_STATE_HEADER 2      // class, id and length
+#define UBX_STATE_PAYLOAD 3
+#define UBX_STATE_CK 4          // two checksum bytes
+
+// NAV-PVT, navigation position velocity time solution
+struct ubxpvt
+{
+    uint32_t itow;          // GPS time of week [ms]
+    uint16_t year;          // UTC
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t valid;          // UBX_PVT_VALIDDATE, UBX_PVT_VALIDTIME
+    uint32_t tacc;          // time accuracy [ns]
+    int32_t nano;           // fraction of second, may be negative [ns]
+    uint8_t fixtype;        // UBX_FIX_...
+    uint8_t flags;          // UBX_PVT_GNSSFIXOK, UBX_PVT_DIFFSOLN
+    uint8_t numsv;          // satellites used
+    int32_t lon;            // [1e-7 degrees]
+    int32_t lat;            // [1e-7 degrees]
+    int32_t height;         // above ellipsoid [mm]
+    int32_t hmsl;           // above mean sea level [mm]
+    uint32_t hacc;          // horizontal accuracy [mm]
+    uint32_t vacc;          // vertical accuracy [mm]
+    int32_t veln;           // north velocity [mm/s]
+    int32_t vele;           // east velocity [mm/s]
+    int32_t veld;           // down velocity [mm/s]
+    int32_t gspeed;         // ground speed [mm/s]
+    int32_t headmot;        // heading of motion [1e-5 degrees]
+    uint32_t sacc;          // speed accuracy [mm/s]
+    uint32_t headacc;       // heading accuracy [1e-5 degrees]
+    uint16_t pdop;          // [0.01]
+};
+typedef struct ubxpvt ubxpvt_t;
+
+// NAV-TIMEUTC, UTC time solution
+struct ubxtimeutc
+{
+    uint32_t itow;          // GPS time of week [ms]
+    uint32_t tacc;          // [ns]
+    int32_t nano;           // [ns]
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t minute;
+    uint8_t second;
+    uint8_t valid;          // UBX_TIMEUTC_VALIDUTC and lower validity bits
+};
+typedef struct ubxtimeutc ubxtimeutc_t;
+
+// Called for every frame with a valid checksum and a parser, record is a ubxpvt_t or
+// ubxtimeutc_t selected by the message id
+typedef void (*ubx_callback)(uint8_t cls, uint8_t id, const void *record, void *ctx);
+
+struct ubxstream
+{
+    int state;
+    int count;              // bytes of the current state received
+    uint8_t header[4];      // class, id, length
+    uint16_t length;
+    uint8_t cka, ckb;       // running Fletcher checksum
+    uint8_t check[2];       // received checksum
+    uint8_t payload[UBXMAXPAYLOAD];
+
+    ubx_callback callback;
+    void *ctx;
+
+    // Counters
+    unsigned long frames;
+    unsigned long checksumerrors;  // including lengths over UBXMAXLENGTH
+    unsigned long skipped;  // frames without a parser or longer than UBXMAXPAYLOAD
+};
+typedef struct ubxstream ubxstream_t;
+
+// Recorded receiver output, memory-mapped
+struct ubxcapture
+{
+    const uint8_t *map;
+    size_t maplen;
+    size_t pos;             // next byte to feed
+};
+typedef struct ubxcapture ubxcapture_t;
+
+void ubx_stream_init(ubxstream_t *, ubx_callback, void *);
+size_t ubx_stream_feed(ubxstream_t *, const uint8_t *, size_t);
+void ubx_parse_pvt(const uint8_t *, ubxpvt_t *);
+void ubx_parse_timeutc(const uint8_t *, ubxtimeutc_t *);
+
+int ubx_capture_open(ubxcapture_t *, const char *);
+void ubx_capture_close(ubxcapture_t *);
+size_t ubx_capture_feed(ubxcapture_t *, ubxstream_t *, size_t, int);
+
+#endif
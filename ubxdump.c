@@ -0,0 +1,99 @@
+/** \file ubxdump.c
+ *  \brief Print the fixes of a recorded UBX capture
+ *
+ *  The capture is memory-mapped and fed through the same parser as the receiver, so a
+ *  capture can be checked without the hardware.  With a number of passes the fixes are not
+ *  printed and the parse rate is reported instead.
+ *
+ *  Usage: ubxdump capture [passes]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ubx.h"
+
+typedef struct dumpstate
+{
+    int print;
+    unsigned long pvt;
+    unsigned long timeutc;
+} dumpstate_s;
+
+/** \brief Print or count a record
+ *
+ * \param UBX class and id, ubxpvt_t or ubxtimeutc_t record, dumpstate_s structure
+ * \return void
+ */
+static void DumpRecord(uint8_t cls, uint8_t id, const void *record, void *ctx)
+{
+    dumpstate_s *d = (dumpstate_s *)ctx;
+    const ubxpvt_t *pvt;
+
+    if(cls != UBX_CLASS_NAV) { return; }
+    if(id == UBX_NAV_TIMEUTC)
+    {
+        d->timeutc++;
+        return;
+    }
+    if(id != UBX_NAV_PVT) { return; }
+
+    d->pvt++;
+    if(!d->print) { return; }
+
+    pvt = (const ubxpvt_t *)record;
+    printf("%04u-%02u-%02uT%02u:%02u:%02u itow %10u fix %u%s sv %2u lat %12.7f lon %12.7f "
+           "alt %8.3f speed %7.3f course %7.3f pdop %5.2f\n",
+           pvt->year, pvt->month, pvt->day, pvt->hour, pvt->minute, pvt->second, pvt->itow,
+           pvt->fixtype, (pvt->flags & UBX_PVT_GNSSFIXOK) ? "+" : " ", pvt->numsv,
+           pvt->lat / 1e7, pvt->lon / 1e7, pvt->hmsl / 1000.0, pvt->gspeed / 1000.0,
+           pvt->headmot / 1e5, pvt->pdop * 0.01);
+}
+
+int main(int argc, char *argv[])
+{
+    ubxcapture_t cap;
+    ubxstream_t s;
+    dumpstate_s d = {1, 0, 0};
+    struct timespec t0, t1;
+    double elapsed;
+    long passes = 1, i;
+
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage: %s capture [passes]\n", argv[0]);
+        return 1;
+    }
+    if(argc > 2)
+    {
+        passes = atol(argv[2]);
+        if(passes < 1) { passes = 1; }
+        d.print = 0;
+    }
+    if(!ubx_capture_open(&cap, argv[1]))
+    {
+        fprintf(stderr, "cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    ubx_stream_init(&s, DumpRecord, &d);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for(i = 0; i < passes; i++)
+    {
+        ubx_stream_feed(&s, cap.map, cap.maplen);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    printf("%lu frames, %lu NAV-PVT, %lu NAV-TIMEUTC, %lu skipped, %lu checksum errors\n",
+           s.frames, d.pvt, d.timeutc, s.skipped, s.checksumerrors);
+    if(argc > 2 && elapsed > 0.0)
+    {
+        printf("%.1f MB/s, %.0f ns/NAV-PVT\n", passes * (double)cap.maplen / elapsed / 1e6,
+               elapsed * 1e9 / d.pvt);
+    }
+
+    ubx_capture_close(&cap);
+
+    return (s.checksumerrors == 0) ? 0 : 1;
+}